@@ -1,9 +1,17 @@
+#include <algorithm>
+#include <cmath>
 #include <cstddef>
 #include <cstdint>
+#include <iterator>
+#include <numeric>
+#include <thread>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
-// Let Catch provide main().
+// Let Catch provide main() and benchmarks.
 #define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
 #include "catch2/catch.hpp"
 
 // Vector is an alias for column vector.
@@ -12,28 +20,92 @@ template <typename T> using Vector = std::vector<T>;
 // Matrix is an alias for matrix of column vectors.
 template <typename T> using Matrix = std::vector<Vector<T>>;
 
+// MatrixView is a non-owning view of a row-major matrix stored in a single
+// contiguous buffer where the start of each row is stride elements apart.
+template <typename T>
+struct MatrixView
+{
+    T* data;
+    std::size_t nrow;
+    std::size_t ncol;
+    std::size_t stride;
+
+    T& operator()(std::size_t i, std::size_t j) const
+    {
+        return data[i*stride + j];
+    }
+};
+
+// make_view returns a view of buf holding nrow rows of ncol elements.
+template <typename T>
+MatrixView<const T>
+make_view(const std::vector<T>& buf, std::size_t nrow, std::size_t ncol)
+{
+    return MatrixView<const T>{buf.data(), nrow, ncol, ncol};
+}
+
+// rows, cols, and at adapt nested vectors and views to a common interface.
+template <typename T>
+std::size_t rows(const Matrix<T>& m)
+{
+    return m.size();
+}
+
+template <typename T>
+std::size_t cols(const Matrix<T>& m)
+{
+    return m.empty() ? 0 : m[0].size();
+}
+
+template <typename T>
+const T& at(const Matrix<T>& m, std::size_t i, std::size_t j)
+{
+    return m[i][j];
+}
+
+template <typename T>
+std::size_t rows(const MatrixView<T>& m)
+{
+    return m.nrow;
+}
+
+template <typename T>
+std::size_t cols(const MatrixView<T>& m)
+{
+    return m.ncol;
+}
+
+template <typename T>
+T& at(const MatrixView<T>& m, std::size_t i, std::size_t j)
+{
+    return m(i, j);
+}
+
 // MatrixVisitorNoOp is a no-op visitor functor.
 template <typename T>
 struct MatrixVisitorNoOp
 {
-    void operator()(const Matrix<T>& m, std::size_t i, std::size_t j)
+    template <typename MatrixT>
+    void operator()(const MatrixT& m, std::size_t i, std::size_t j)
     { }
 };
 
 // spiral2d visits every cell of the matrix in a clockwise spiral.
-template <typename T, typename MatrixVisitor>
+// The matrix is either nested vectors or a MatrixView.
+template <typename MatrixT, typename MatrixVisitor>
 void
-spiral2d(const Matrix<T>& m, MatrixVisitor& visitor)
+spiral2d(const MatrixT& m, MatrixVisitor& visitor)
 {
-    std::size_t nrow = m.size(), ncol = m[0].empty() ? 0 : m[0].size();
+    std::size_t nrow = rows(m), ncol = cols(m);
     std::size_t ncells = nrow*ncol, visited = 0;
 
     // i,j index row and column.
     std::size_t i = 0, j = 0;
 
     // move is the direction of travel along the spiral.
+    // A single column has no room to move right, so travel starts down.
     enum direction { right, down, left, up };
-    direction move = right;
+    direction move = ncol == 1 ? down : right;
 
     // leftlim, rightlim, downlim, and uplim are limits of travel.
     // limits are dynamically adjusted during traversal to spiral inward.
@@ -81,14 +153,353 @@ spiral2d(const Matrix<T>& m, MatrixVisitor& visitor)
 template <typename T>
 struct MatrixVisitorVisitOrder
 {
-    void operator()(const Matrix<T>& m, std::size_t i, std::size_t j)
+    template <typename MatrixT>
+    void operator()(const MatrixT& m, std::size_t i, std::size_t j)
     {
-        visit_order.emplace_back(m[i][j]);
+        visit_order.emplace_back(at(m, i, j));
     }
 
     std::vector<T> visit_order;
 };
 
+// Direction is the direction of travel along the spiral.
+enum class Direction { right, down, left, up };
+
+// Segment is a run of cells along one side of a ring of the spiral which
+// starts at row i and column j and moves length cells in direction move.
+struct Segment
+{
+    std::size_t i;
+    std::size_t j;
+    std::size_t length;
+    Direction move;
+};
+
+// step returns the distance in elements between consecutive cells of seg
+// in the buffer of m.  Rows are contiguous and columns are stride apart.
+template <typename T>
+std::ptrdiff_t step(const MatrixView<T>& m, const Segment& seg)
+{
+    auto stride = static_cast<std::ptrdiff_t>(m.stride);
+    switch (seg.move) {
+        case Direction::right: return 1;
+        case Direction::down: return stride;
+        case Direction::left: return -1;
+        case Direction::up: return -stride;
+    }
+    return 0;
+}
+
+// for_each_ring_segment invokes fn with each nonempty side of ring r of an
+// nrow x ncol matrix in spiral order.  Ring r is bounded by rows
+// [r, nrow-1-r] and columns [r, ncol-1-r].
+template <typename Fn>
+void
+for_each_ring_segment(std::size_t nrow, std::size_t ncol, std::size_t r,
+                      Fn&& fn)
+{
+    std::size_t top = r, left = r, bottom = nrow-1-r, right = ncol-1-r;
+
+    // Top row from left to right.
+    fn(Segment{top, left, right-left+1, Direction::right});
+    // Right column from below the top row to the bottom.
+    if (bottom > top) {
+        fn(Segment{top+1, right, bottom-top, Direction::down});
+    }
+    // Bottom row from right to left unless it is the top row.
+    if (bottom > top && right > left) {
+        fn(Segment{bottom, right-1, right-left, Direction::left});
+    }
+    // Left column from bottom to top unless it is the right column.
+    if (bottom > top+1 && right > left) {
+        fn(Segment{bottom-1, left, bottom-top-1, Direction::up});
+    }
+}
+
+// num_rings returns the number of rings of an nrow x ncol matrix.
+std::size_t num_rings(std::size_t nrow, std::size_t ncol)
+{
+    return (std::min(nrow, ncol)+1)/2;
+}
+
+// spiral2d_segments visits the same cells in the same order as spiral2d,
+// but passes the visitor a whole side of each ring at a time.
+template <typename MatrixT, typename SegmentVisitor>
+void
+spiral2d_segments(const MatrixT& m, SegmentVisitor& visitor)
+{
+    std::size_t nrow = rows(m), ncol = cols(m);
+    for (std::size_t r = 0; r < num_rings(nrow, ncol); ++r) {
+        for_each_ring_segment(nrow, ncol, r, [&m, &visitor](Segment seg) {
+            visitor(m, seg);
+        });
+    }
+}
+
+// MatrixSegmentVisitOrder remembers the visit order of a traversal
+// by segments.
+template <typename T>
+struct MatrixSegmentVisitOrder
+{
+    // Generic matrices are visited one cell at a time.
+    template <typename MatrixT>
+    void operator()(const MatrixT& m, const Segment& seg)
+    {
+        std::size_t i = seg.i, j = seg.j;
+        for (std::size_t k = 0; k < seg.length; ++k) {
+            visit_order.emplace_back(at(m, i, j));
+            switch (seg.move) {
+                case Direction::right: ++j; break;
+                case Direction::down: ++i; break;
+                case Direction::left: --j; break;
+                case Direction::up: --i; break;
+            }
+        }
+    }
+
+    // Views are visited by bulk copies of rows and strided copies of
+    // columns directly from the buffer.
+    template <typename U>
+    void operator()(const MatrixView<U>& m, const Segment& seg)
+    {
+        auto first = &m(seg.i, seg.j);
+        auto out = visit_order.size();
+        visit_order.resize(out + seg.length);
+        if (seg.move == Direction::right) {
+            std::copy(first, first+seg.length, &visit_order[out]);
+        }
+        else if (seg.move == Direction::left) {
+            std::reverse_copy(first+1-seg.length, first+1, &visit_order[out]);
+        }
+        else {
+            auto stride = step(m, seg);
+            for (std::size_t k = 0; k < seg.length; ++k, first += stride) {
+                visit_order[out+k] = *first;
+            }
+        }
+    }
+
+    std::vector<T> visit_order;
+};
+
+// cell returns the row and column of the cell at offset t within seg.
+std::pair<std::size_t, std::size_t> cell(const Segment& seg, std::size_t t)
+{
+    switch (seg.move) {
+        case Direction::right: return {seg.i, seg.j+t};
+        case Direction::down: return {seg.i+t, seg.j};
+        case Direction::left: return {seg.i, seg.j-t};
+        case Direction::up: return {seg.i-t, seg.j};
+    }
+    return {seg.i, seg.j};
+}
+
+// cells_before_ring returns the spiral index of the first cell of ring r.
+std::size_t cells_before_ring(std::size_t nrow, std::size_t ncol,
+                              std::size_t r)
+{
+    // Every cell outside of the (nrow-2r) x (ncol-2r) interior.
+    return nrow*ncol - (nrow-2*r)*(ncol-2*r);
+}
+
+// spiral_ring returns the ring which holds the cell at spiral index k.
+std::size_t spiral_ring(std::size_t nrow, std::size_t ncol, std::size_t k)
+{
+    // cells_before_ring(r) = 2r(nrow+ncol) - 4r^2 <= k holds for r up to the
+    // smaller root of the quadratic.  Take its floor and then correct for
+    // rounding error with integer comparisons.
+    double s = static_cast<double>(nrow+ncol);
+    double root = (s - std::sqrt(std::max(0.0, s*s - 4.0*k)))/4.0;
+    std::size_t r = std::min(static_cast<std::size_t>(root),
+                             num_rings(nrow, ncol)-1);
+    while (r > 0 && cells_before_ring(nrow, ncol, r) > k) {
+        --r;
+    }
+    while (r+1 < num_rings(nrow, ncol)
+           && cells_before_ring(nrow, ncol, r+1) <= k) {
+        ++r;
+    }
+    return r;
+}
+
+// spiral_coord returns the row and column of the cell at spiral index k of
+// an nrow x ncol matrix in O(1).
+std::pair<std::size_t, std::size_t>
+spiral_coord(std::size_t nrow, std::size_t ncol, std::size_t k)
+{
+    auto r = spiral_ring(nrow, ncol, k);
+    auto offset = k - cells_before_ring(nrow, ncol, r);
+    std::pair<std::size_t, std::size_t> ij{r, r};
+    bool found = false;
+    for_each_ring_segment(nrow, ncol, r, [&](Segment seg) {
+        if (found) {
+            return;
+        }
+        if (offset < seg.length) {
+            ij = cell(seg, offset);
+            found = true;
+        }
+        else {
+            offset -= seg.length;
+        }
+    });
+    return ij;
+}
+
+// spiral_index returns the spiral index of the cell at row i and column j
+// of an nrow x ncol matrix in O(1).
+std::size_t
+spiral_index(std::size_t nrow, std::size_t ncol, std::size_t i, std::size_t j)
+{
+    // The ring is the distance to the nearest edge.
+    auto r = std::min({i, j, nrow-1-i, ncol-1-j});
+    std::size_t top = r, left = r, bottom = nrow-1-r, right = ncol-1-r;
+    std::size_t w = right-left+1, h = bottom-top+1;
+    auto k = cells_before_ring(nrow, ncol, r);
+    if (i == top) {
+        return k + (j-left);
+    }
+    if (j == right) {
+        return k + w + (i-top-1);
+    }
+    if (i == bottom) {
+        return k + w + (h-1) + (right-1-j);
+    }
+    return k + w + (h-1) + (w-1) + (bottom-1-i);
+}
+
+// spiral2d_range visits the cells with spiral index in [first, last) in
+// spiral order without visiting the cells before first.
+template <typename MatrixT, typename MatrixVisitor>
+void
+spiral2d_range(const MatrixT& m, std::size_t first, std::size_t last,
+               MatrixVisitor& visitor)
+{
+    std::size_t nrow = rows(m), ncol = cols(m);
+    if (first >= last) {
+        return;
+    }
+    auto r = spiral_ring(nrow, ncol, first);
+    std::size_t skip = first - cells_before_ring(nrow, ncol, r);
+    std::size_t remaining = last - first;
+    for (; r < num_rings(nrow, ncol) && remaining > 0; ++r) {
+        for_each_ring_segment(nrow, ncol, r, [&](Segment seg) {
+            for (std::size_t t = skip; t < seg.length && remaining > 0; ++t) {
+                auto ij = cell(seg, t);
+                visitor(m, ij.first, ij.second);
+                --remaining;
+            }
+            skip -= std::min(skip, seg.length);
+        });
+    }
+}
+
+// spiral2d_parallel visits every cell of the matrix in a clockwise spiral
+// using nthreads threads which each visit a contiguous range of spiral
+// indices.  Each thread uses the visitor returned by make_visitor(first),
+// where first is the spiral index of the first cell it visits.
+template <typename MatrixT, typename VisitorFactory>
+void
+spiral2d_parallel(const MatrixT& m, VisitorFactory make_visitor,
+                  std::size_t nthreads=std::thread::hardware_concurrency())
+{
+    std::size_t ncells = rows(m)*cols(m);
+    nthreads = std::max<std::size_t>(nthreads, 1);
+    std::size_t chunk = (ncells+nthreads-1)/nthreads;
+
+    auto work = [&m, &make_visitor](std::size_t first, std::size_t last) {
+        auto visitor = make_visitor(first);
+        spiral2d_range(m, first, last, visitor);
+    };
+    std::vector<std::thread> threads;
+    for (std::size_t tid = 1; tid < nthreads; ++tid) {
+        auto first = std::min(ncells, tid*chunk);
+        auto last = std::min(ncells, first+chunk);
+        threads.emplace_back(work, first, last);
+    }
+    work(0, std::min(ncells, chunk));  // Calling thread takes the first.
+    for (auto& t : threads) {
+        t.join();
+    }
+}
+
+// MatrixVisitorWriteOrder writes the visit order of a traversal to
+// consecutive positions of an output buffer.
+template <typename T>
+struct MatrixVisitorWriteOrder
+{
+    template <typename MatrixT>
+    void operator()(const MatrixT& m, std::size_t i, std::size_t j)
+    {
+        *out++ = at(m, i, j);
+    }
+
+    T* out;
+};
+
+// spiral2d_transform writes the cells of m to out in spiral order.
+//
+// The column sides of a ring walk down or up a column of a row-major matrix
+// and so touch a new cache line, and for large matrices a new page, at every
+// step.  To keep memory access sequential, rings are processed in groups of
+// block rings whose right columns, and likewise left columns, are adjacent.
+// Walking down the rows once per group reads the block adjacent cells of
+// each row together and scatters them to block sequential output streams.
+template <typename T>
+void
+spiral2d_transform(const MatrixView<T>& m, std::remove_const_t<T>* out,
+                   std::size_t block=16)
+{
+    std::size_t nrow = rows(m), ncol = cols(m);
+    block = std::max<std::size_t>(block, 1);
+
+    // down and up hold the output offset of the right and left column
+    // sides of each ring in the group or npos when the side is empty.
+    static constexpr std::size_t npos = SIZE_MAX;
+    std::vector<std::size_t> down(block), up(block);
+
+    for (std::size_t r0 = 0; r0 < num_rings(nrow, ncol); r0 += block) {
+        auto r1 = std::min(r0+block, num_rings(nrow, ncol));
+
+        // Copy the rows directly and record the offsets of the columns.
+        for (auto r = r0; r < r1; ++r) {
+            auto offset = cells_before_ring(nrow, ncol, r);
+            down[r-r0] = up[r-r0] = npos;
+            for_each_ring_segment(nrow, ncol, r, [&](Segment seg) {
+                auto first = &m(seg.i, seg.j);
+                if (seg.move == Direction::right) {
+                    std::copy(first, first+seg.length, out+offset);
+                }
+                else if (seg.move == Direction::left) {
+                    std::reverse_copy(first+1-seg.length, first+1,
+                                      out+offset);
+                }
+                else if (seg.move == Direction::down) {
+                    down[r-r0] = offset;
+                }
+                else {
+                    up[r-r0] = offset;
+                }
+                offset += seg.length;
+            });
+        }
+
+        // Walk down the rows spanned by the columns of the group.
+        for (auto i = r0+1; i+r0 < nrow; ++i) {
+            for (auto r = r0; r < r1 && r < i; ++r) {
+                // Right column of ring r covers rows [r+1, nrow-1-r].
+                if (down[r-r0] != npos && i+r < nrow) {
+                    out[down[r-r0] + (i-r-1)] = m(i, ncol-1-r);
+                }
+                // Left column of ring r covers rows [r+1, nrow-2-r] upward.
+                if (up[r-r0] != npos && i+r+1 < nrow) {
+                    out[up[r-r0] + (nrow-2-r-i)] = m(i, r);
+                }
+            }
+        }
+    }
+}
+
 TEST_CASE("examples", "[spiral2d]")
 {
     using T = std::uint32_t;
@@ -114,6 +525,26 @@ TEST_CASE("examples", "[spiral2d]")
         {
             { {1,2,3}, {4,5,6}, {7,8,9}, {10,11,12} },
             {1,2,3,6,9,12,11,10,7,4,5,8}
+        },
+        // Spiral over a 3x4 rectangular matrix.
+        {
+            { {1,2,3,4}, {5,6,7,8}, {9,10,11,12} },
+            {1,2,3,4,8,12,11,10,9,5,6,7}
+        },
+        // Spiral over a single row.
+        {
+            { {1,2,3} },
+            {1,2,3}
+        },
+        // Spiral over a single column.
+        {
+            { {1}, {2}, {3} },
+            {1,2,3}
+        },
+        // Spiral over a single cell.
+        {
+            { {1} },
+            {1}
         }
     };
 
@@ -122,5 +553,188 @@ TEST_CASE("examples", "[spiral2d]")
         spiral2d(c.m, visitor);
         CAPTURE(c.m, visitor.visit_order, c.expected);
         REQUIRE(visitor.visit_order == c.expected);
+
+        // Copy the matrix into a contiguous buffer and spiral over a view.
+        std::vector<T> buf;
+        for (const auto& row : c.m) {
+            buf.insert(std::end(buf), std::begin(row), std::end(row));
+        }
+        MatrixVisitorVisitOrder<T> view_visitor;
+        spiral2d(make_view(buf, rows(c.m), cols(c.m)), view_visitor);
+        REQUIRE(view_visitor.visit_order == c.expected);
+
+        // Spiral over segments of both the nested vectors and the view.
+        MatrixSegmentVisitOrder<T> segment_visitor;
+        spiral2d_segments(c.m, segment_visitor);
+        REQUIRE(segment_visitor.visit_order == c.expected);
+        MatrixSegmentVisitOrder<T> view_segment_visitor;
+        spiral2d_segments(make_view(buf, rows(c.m), cols(c.m)),
+                          view_segment_visitor);
+        REQUIRE(view_segment_visitor.visit_order == c.expected);
+    }
+}
+
+TEST_CASE("strided view", "[spiral2d]")
+{
+    using T = std::uint32_t;
+
+    // Spiral over the 3x3 interior of a 5x5 matrix.
+    std::vector<T> buf{
+         0,  0,  0,  0,  0,
+         0,  1,  2,  3,  0,
+         0,  4,  5,  6,  0,
+         0,  7,  8,  9,  0,
+         0,  0,  0,  0,  0
+    };
+    MatrixView<const T> interior{buf.data()+6, 3, 3, 5};
+
+    MatrixVisitorVisitOrder<T> visitor;
+    spiral2d(interior, visitor);
+    std::vector<T> expected{1,2,3,6,9,8,7,4,5};
+    REQUIRE(visitor.visit_order == expected);
+}
+
+TEST_CASE("segments", "[spiral2d]")
+{
+    using T = std::uint32_t;
+
+    // Compare the traversal by segments to spiral2d over every shape.
+    for (std::size_t nrow = 1; nrow <= 9; ++nrow) {
+        for (std::size_t ncol = 1; ncol <= 9; ++ncol) {
+            std::vector<T> buf(nrow*ncol);
+            std::iota(std::begin(buf), std::end(buf), T{0});
+            auto m = make_view(buf, nrow, ncol);
+
+            MatrixVisitorVisitOrder<T> expected;
+            spiral2d(m, expected);
+            MatrixSegmentVisitOrder<T> rcv;
+            spiral2d_segments(m, rcv);
+            CAPTURE(nrow, ncol);
+            REQUIRE(rcv.visit_order == expected.visit_order);
+        }
+    }
+}
+
+TEST_CASE("random access", "[spiral2d]")
+{
+    using T = std::uint32_t;
+
+    for (std::size_t nrow = 1; nrow <= 12; ++nrow) {
+        for (std::size_t ncol = 1; ncol <= 12; ++ncol) {
+            std::vector<T> buf(nrow*ncol);
+            std::iota(std::begin(buf), std::end(buf), T{0});
+            auto m = make_view(buf, nrow, ncol);
+            MatrixVisitorVisitOrder<T> expected;
+            spiral2d(m, expected);
+            CAPTURE(nrow, ncol);
+
+            // Map between spiral index and cell in both directions.
+            for (std::size_t k = 0; k < nrow*ncol; ++k) {
+                auto ij = spiral_coord(nrow, ncol, k);
+                CAPTURE(k, ij);
+                REQUIRE(m(ij.first, ij.second) == expected.visit_order[k]);
+                REQUIRE(spiral_index(nrow, ncol, ij.first, ij.second) == k);
+            }
+
+            // Visit every range of spiral indices.
+            for (std::size_t first = 0; first <= nrow*ncol; ++first) {
+                auto last = std::min(nrow*ncol, first+5);
+                MatrixVisitorVisitOrder<T> rcv;
+                spiral2d_range(m, first, last, rcv);
+                REQUIRE(rcv.visit_order == std::vector<T>(
+                    std::begin(expected.visit_order)+first,
+                    std::begin(expected.visit_order)+last));
+            }
+
+            // Flatten in parallel by writing each range to its offset.
+            for (std::size_t nthreads : {1, 3, 8}) {
+                std::vector<T> rcv(nrow*ncol);
+                spiral2d_parallel(m, [&rcv](std::size_t first) {
+                    return MatrixVisitorWriteOrder<T>{rcv.data()+first};
+                }, nthreads);
+                REQUIRE(rcv == expected.visit_order);
+            }
+        }
+    }
+
+    // Large matrices exercise the closed form beyond rounding error.
+    std::size_t nrow = 30000, ncol = 20001;
+    for (std::size_t k : {std::size_t{0}, std::size_t{99999},
+                          std::size_t{123456789}, nrow*ncol-1}) {
+        auto ij = spiral_coord(nrow, ncol, k);
+        REQUIRE(spiral_index(nrow, ncol, ij.first, ij.second) == k);
+    }
+}
+
+TEST_CASE("transform", "[spiral2d]")
+{
+    using T = std::uint32_t;
+
+    for (std::size_t nrow = 1; nrow <= 20; ++nrow) {
+        for (std::size_t ncol = 1; ncol <= 20; ++ncol) {
+            std::vector<T> buf(nrow*ncol);
+            std::iota(std::begin(buf), std::end(buf), T{0});
+            auto m = make_view(buf, nrow, ncol);
+            MatrixVisitorVisitOrder<T> expected;
+            spiral2d(m, expected);
+
+            for (std::size_t block : {1, 2, 3, 16}) {
+                CAPTURE(nrow, ncol, block);
+                std::vector<T> rcv(nrow*ncol);
+                spiral2d_transform(m, rcv.data(), block);
+                REQUIRE(rcv == expected.visit_order);
+            }
+        }
     }
 }
+
+TEST_CASE("segments benchmark", "[.benchmark][spiral2d]")
+{
+    using T = std::uint32_t;
+
+    std::size_t n = 1024;
+    std::vector<T> buf(n*n);
+    std::iota(std::begin(buf), std::end(buf), T{0});
+    auto m = make_view(buf, n, n);
+
+    BENCHMARK("MatrixVisitorVisitOrder")
+    {
+        MatrixVisitorVisitOrder<T> visitor;
+        visitor.visit_order.reserve(n*n);
+        spiral2d(m, visitor);
+        return visitor.visit_order.size();
+    };
+
+    BENCHMARK("MatrixSegmentVisitOrder")
+    {
+        MatrixSegmentVisitOrder<T> visitor;
+        visitor.visit_order.reserve(n*n);
+        spiral2d_segments(m, visitor);
+        return visitor.visit_order.size();
+    };
+}
+
+TEST_CASE("transform benchmark", "[.benchmark][spiral2d]")
+{
+    using T = std::uint32_t;
+
+    // A matrix well beyond the size of the last level cache.
+    std::size_t n = 8192;
+    std::vector<T> buf(n*n);
+    std::iota(std::begin(buf), std::end(buf), T{0});
+    auto m = make_view(buf, n, n);
+    std::vector<T> out(n*n);
+
+    BENCHMARK("MatrixVisitorWriteOrder")
+    {
+        MatrixVisitorWriteOrder<T> visitor{out.data()};
+        spiral2d(m, visitor);
+        return out.size();
+    };
+
+    BENCHMARK("spiral2d_transform")
+    {
+        spiral2d_transform(m, out.data());
+        return out.size();
+    };
+}
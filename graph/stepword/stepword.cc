@@ -1,15 +1,896 @@
 #include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <istream>
 #include <string>
+#include <string_view>
 #include <iterator>
 #include <memory>
+#include <optional>
+#include <ostream>
 #include <queue>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 // Let Catch provide main().
 #define CATCH_CONFIG_MAIN
 #include "catch2/catch.hpp"
 
+// is_one_character_different is true when s1 and s2 differ by one char.
+bool
+is_one_character_different(std::string_view s1, std::string_view s2)
+{
+    if (s1.size() != s2.size()) {
+        return false;
+    }
+    int cnt_diff = 0;
+    for (std::size_t ii = 0; ii < s1.size(); ++ii) {
+        if (s1[ii] != s2[ii] && ++cnt_diff > 1) {
+            break;
+        }
+    }
+    return cnt_diff == 1;
+}
+
+// WildcardIndex maps each word with one position erased to the words
+// matching that pattern at that position, e.g. dg at 1 -> { dig, dog, dug }.
+//
+// Patterns are kept apart by position rather than marked with a wildcard
+// character, which could also appear in the words themselves.
+class WildcardIndex
+{
+  public:
+    explicit WildcardIndex(const std::vector<std::string>& words)
+        : words_(words)
+    {
+        for (std::size_t id = 0; id < words_.size(); ++id) {
+            const auto& word = words_[id];
+            if (buckets_.size() < word.size()) {
+                buckets_.resize(word.size());
+            }
+            for (std::size_t ii = 0; ii < word.size(); ++ii) {
+                buckets_[ii][erase(word, ii)].emplace_back(id);
+            }
+        }
+    }
+
+    // for_each_neighbor invokes visit with every word which differs from
+    // word by exactly one character using one bucket lookup per position.
+    template <typename Visitor>
+    void for_each_neighbor(const std::string& word, Visitor&& visit) const
+    {
+        for_each_neighbor_id(word, [this, &visit](std::size_t id) {
+            visit(words_[id]);
+        });
+    }
+
+    // for_each_neighbor_id is for_each_neighbor with the neighbor given by
+    // its position in the dictionary used to build the index.
+    template <typename Visitor>
+    void for_each_neighbor_id(const std::string& word, Visitor&& visit) const
+    {
+        auto npositions = std::min(word.size(), buckets_.size());
+        for (std::size_t ii = 0; ii < npositions; ++ii) {
+            auto bucket = buckets_[ii].find(erase(word, ii));
+            if (bucket == std::end(buckets_[ii])) {
+                continue;
+            }
+            // Every word in the bucket matches word apart from position ii,
+            // so only word itself needs to be excluded.
+            for (const auto id : bucket->second) {
+                if (words_[id][ii] != word[ii]) {
+                    visit(id);
+                }
+            }
+        }
+    }
+
+  private:
+    // erase returns word without the character at position ii.
+    static std::string erase(const std::string& word, std::size_t ii)
+    {
+        std::string pattern;
+        pattern.reserve(word.size()-1);
+        pattern.append(word, 0, ii);
+        pattern.append(word, ii+1, std::string::npos);
+        return pattern;
+    }
+
+    // words_ holds the dictionary referred to by buckets_.
+    std::vector<std::string> words_;
+
+    // buckets_[ii] maps a pattern with position ii erased to the index of
+    // each word matching it.
+    std::vector<std::unordered_map<std::string, std::vector<std::size_t>>>
+        buckets_;
+};
+
+struct WordGraphError : std::runtime_error
+{
+    using std::runtime_error::runtime_error;
+};
+
+// WordGraph is the graph of one-character transformations over a fixed
+// dictionary, built once and shared by any number of queries.
+//
+// Words are interned to dense ids given by their rank in sorted order and
+// edges are held in compressed sparse row (CSR) form.  The graph is a single
+// flat buffer so that it can be written to a file and later used in place
+// from a memory mapped region without any parsing.  The buffer consists of
+// the following 8-byte aligned sections:
+// * Header    : magic, number of words, number of edges, size of text.
+// * Rows      : nwords+1 offsets into columns.
+// * Columns   : ids of the neighbors of each word.
+// * Offsets   : nwords+1 offsets into text.
+// * Text      : concatenated characters of all words in sorted order.
+class WordGraph
+{
+  public:
+    // Copies are disallowed since sections point into the owned buffer.
+    WordGraph(const WordGraph&) = delete;
+    WordGraph& operator=(const WordGraph&) = delete;
+    WordGraph(WordGraph&&) = default;
+    WordGraph& operator=(WordGraph&&) = default;
+
+    // WordGraph builds the graph over the distinct words of valid_words.
+    explicit WordGraph(const std::vector<std::string>& valid_words)
+    {
+        // Intern words by sorting so that ids can be found without a table.
+        auto words = valid_words;
+        std::sort(std::begin(words), std::end(words));
+        words.erase(std::unique(std::begin(words), std::end(words)),
+                    std::end(words));
+
+        // Ids, rows and text offsets are held in 32 bits.
+        std::uint64_t ntext = 0;
+        for (const auto& w : words) {
+            ntext += w.size();
+        }
+        if (words.size() >= UINT32_MAX || ntext > UINT32_MAX) {
+            throw WordGraphError("too many words for a word graph");
+        }
+
+        // Discover the neighbors of every word using the wildcard index,
+        // whose ids are positions in words and hence equal to our ids.
+        const WildcardIndex index(words);
+        std::vector<std::uint32_t> rows{0}, cols;
+        rows.reserve(words.size()+1);
+        for (const auto& w : words) {
+            auto first = cols.size();
+            index.for_each_neighbor_id(w, [&cols](std::size_t id) {
+                cols.emplace_back(static_cast<std::uint32_t>(id));
+            });
+            std::sort(std::begin(cols)+first, std::end(cols));
+            if (cols.size() > UINT32_MAX) {
+                throw WordGraphError("too many edges for a word graph");
+            }
+            rows.emplace_back(static_cast<std::uint32_t>(cols.size()));
+        }
+
+        Header header{magic, words.size(), cols.size(), ntext};
+        owned_.resize(layout_size(header));
+        std::memcpy(owned_.data(), &header, sizeof(header));
+        attach(reinterpret_cast<const char*>(owned_.data()),
+               owned_.size()*sizeof(std::uint64_t), header);
+
+        // Copy the adjacency and text into the buffer.
+        std::memcpy(const_cast<std::uint32_t*>(rows_), rows.data(),
+                    rows.size()*sizeof(std::uint32_t));
+        std::memcpy(const_cast<std::uint32_t*>(cols_), cols.data(),
+                    cols.size()*sizeof(std::uint32_t));
+        auto offsets = const_cast<std::uint32_t*>(offsets_);
+        auto text = const_cast<char*>(text_);
+        std::uint32_t offset = 0;
+        for (std::size_t id = 0; id < words.size(); ++id) {
+            offsets[id] = offset;
+            std::memcpy(text+offset, words[id].data(), words[id].size());
+            offset += words[id].size();
+        }
+        offsets[words.size()] = offset;
+    }
+
+    // view returns a graph which refers to a buffer previously obtained
+    // from data(), e.g. a memory mapped file. The buffer must outlive the
+    // graph and be 8-byte aligned.
+    static WordGraph view(const char* data, std::size_t size)
+    {
+        if (reinterpret_cast<std::uintptr_t>(data) % alignof(Header) != 0) {
+            throw WordGraphError("buffer is not aligned");
+        }
+        if (size < sizeof(Header)) {
+            throw WordGraphError("buffer is truncated");
+        }
+        Header header;
+        std::memcpy(&header, data, sizeof(header));
+        if (header.magic != magic) {
+            throw WordGraphError("buffer is not a word graph");
+        }
+        check_header(header);
+        if (size < layout_size(header)*sizeof(std::uint64_t)) {
+            throw WordGraphError("buffer is truncated");
+        }
+        WordGraph graph;
+        graph.attach(data, size, header);
+        graph.check(header);
+        return graph;
+    }
+
+    // load returns a graph read from is which was written by save.
+    static WordGraph load(std::istream& is)
+    {
+        Header header;
+        if (!is.read(reinterpret_cast<char*>(&header), sizeof(header))
+            || header.magic != magic) {
+            throw WordGraphError("stream is not a word graph");
+        }
+        check_header(header);
+
+        // Grow the buffer as the sections are read rather than allocating
+        // the size given by the header up front, so that a corrupt header
+        // fails with a short read instead of a huge allocation.
+        constexpr std::size_t chunk = 1 << 17;  // 1 MiB in units of 8 bytes.
+        auto nbuf = layout_size(header);
+        WordGraph graph;
+        graph.owned_.resize(sizeof(header)/sizeof(std::uint64_t));
+        std::memcpy(graph.owned_.data(), &header, sizeof(header));
+        while (graph.owned_.size() < nbuf) {
+            auto pos = graph.owned_.size();
+            auto n = std::min(chunk, nbuf - pos);
+            graph.owned_.resize(pos + n);
+            if (!is.read(reinterpret_cast<char*>(graph.owned_.data() + pos),
+                         n*sizeof(std::uint64_t))) {
+                throw WordGraphError("stream is truncated");
+            }
+        }
+        auto buf = reinterpret_cast<const char*>(graph.owned_.data());
+        graph.attach(buf, nbuf*sizeof(std::uint64_t), header);
+        graph.check(header);
+        return graph;
+    }
+
+    // save writes the graph to os.
+    void save(std::ostream& os) const
+    {
+        os.write(data_, size_);
+    }
+
+    // data returns the flat buffer which holds the graph.
+    const char* data() const
+    {
+        return data_;
+    }
+
+    // size returns the size of the flat buffer in bytes.
+    std::size_t size() const
+    {
+        return size_;
+    }
+
+    // num_words returns the number of vertices in the graph.
+    std::uint32_t num_words() const
+    {
+        return nwords_;
+    }
+
+    // num_edges returns the number of directed edges in the graph.
+    std::uint32_t num_edges() const
+    {
+        return rows_[nwords_];
+    }
+
+    // id returns the id of word or nullopt when word is not in the graph.
+    std::optional<std::uint32_t> id(std::string_view word) const
+    {
+        // Binary search over words, which are stored in sorted order.
+        std::uint32_t lo = 0, hi = nwords_;
+        while (lo < hi) {
+            auto mid = lo + (hi-lo)/2;
+            if (this->word(mid) < word) {
+                lo = mid+1;
+            }
+            else {
+                hi = mid;
+            }
+        }
+        if (lo < nwords_ && this->word(lo) == word) {
+            return lo;
+        }
+        return std::nullopt;
+    }
+
+    // word returns the word with the given id.
+    std::string_view word(std::uint32_t id) const
+    {
+        return std::string_view(text_+offsets_[id],
+                                offsets_[id+1]-offsets_[id]);
+    }
+
+    // neighbors_begin and neighbors_end delimit the neighbors of id.
+    const std::uint32_t* neighbors_begin(std::uint32_t id) const
+    {
+        return cols_ + rows_[id];
+    }
+    const std::uint32_t* neighbors_end(std::uint32_t id) const
+    {
+        return cols_ + rows_[id+1];
+    }
+
+  private:
+    static constexpr std::uint64_t magic = 0x48504152474d5257;  // WRMGRAPH
+
+    struct Header
+    {
+        std::uint64_t magic;
+        std::uint64_t nwords;
+        std::uint64_t nedges;
+        std::uint64_t ntext;
+    };
+
+    WordGraph() = default;
+
+    // check_header throws unless the section sizes fit the 32-bit ids and
+    // offsets of the graph, which also keeps layout_size from overflowing.
+    static void check_header(const Header& header)
+    {
+        constexpr std::uint64_t max32 = UINT32_MAX;
+        if (header.nwords >= max32 || header.nedges > max32
+            || header.ntext > max32) {
+            throw WordGraphError("word graph is too large");
+        }
+    }
+
+    // check throws unless the sections attached for header are consistent,
+    // so that neighbors and words stay within the buffer and every neighbor
+    // is a word of the same length which differs in exactly one position,
+    // as the searches assume.
+    void check(const Header& header) const
+    {
+        // Both rows_ and offsets_ must be monotone and end within the
+        // section they index.
+        auto monotone = [&header](const std::uint32_t* xs,
+                                  std::uint64_t last) {
+            if (xs[0] != 0 || xs[header.nwords] > last) {
+                return false;
+            }
+            for (std::uint64_t id = 0; id < header.nwords; ++id) {
+                if (xs[id] > xs[id+1]) {
+                    return false;
+                }
+            }
+            return true;
+        };
+        if (!monotone(rows_, header.nedges)) {
+            throw WordGraphError("word graph rows are corrupt");
+        }
+        if (!monotone(offsets_, header.ntext)) {
+            throw WordGraphError("word graph offsets are corrupt");
+        }
+        for (std::uint32_t id = 0; id < header.nwords; ++id) {
+            for (auto p = neighbors_begin(id); p != neighbors_end(id); ++p) {
+                if (*p >= header.nwords
+                    || !is_one_character_different(word(id), word(*p))) {
+                    throw WordGraphError("word graph neighbor is corrupt");
+                }
+            }
+        }
+    }
+
+    // layout_size returns the size of the buffer in units of 8 bytes.
+    static std::size_t layout_size(const Header& header)
+    {
+        auto words = [](std::uint64_t nbytes) { return (nbytes+7)/8; };
+        return words(sizeof(Header))
+            + words((header.nwords+1)*sizeof(std::uint32_t))
+            + words(header.nedges*sizeof(std::uint32_t))
+            + words((header.nwords+1)*sizeof(std::uint32_t))
+            + words(header.ntext);
+    }
+
+    // attach points the sections of the graph into the buffer at data.
+    void attach(const char* data, std::size_t size, const Header& header)
+    {
+        auto round = [](std::uint64_t nbytes) { return (nbytes+7)/8*8; };
+        data_ = data;
+        size_ = size;
+        nwords_ = static_cast<std::uint32_t>(header.nwords);
+        data += round(sizeof(Header));
+        rows_ = reinterpret_cast<const std::uint32_t*>(data);
+        data += round((header.nwords+1)*sizeof(std::uint32_t));
+        cols_ = reinterpret_cast<const std::uint32_t*>(data);
+        data += round(header.nedges*sizeof(std::uint32_t));
+        offsets_ = reinterpret_cast<const std::uint32_t*>(data);
+        data += round((header.nwords+1)*sizeof(std::uint32_t));
+        text_ = data;
+    }
+
+    // owned_ holds the buffer unless the graph is a view.
+    std::vector<std::uint64_t> owned_;
+
+    const char* data_{nullptr};
+    std::size_t size_{0};
+    std::uint32_t nwords_{0};
+    const std::uint32_t* rows_{nullptr};
+    const std::uint32_t* cols_{nullptr};
+    const std::uint32_t* offsets_{nullptr};
+    const char* text_{nullptr};
+};
+
+// IndexedMinHeap is a binary min heap of ids in [0, n) which supports
+// decreasing the key of an id already in the heap in O(log n).
+class IndexedMinHeap
+{
+  public:
+    explicit IndexedMinHeap(std::size_t n)
+        : positions_(n, npos)
+    { }
+
+    bool empty() const
+    {
+        return heap_.empty();
+    }
+
+    // contains returns true when id is in the heap.
+    bool contains(std::uint32_t id) const
+    {
+        return positions_[id] != npos;
+    }
+
+    // clear removes every id from the heap.
+    void clear()
+    {
+        for (const auto& entry : heap_) {
+            positions_[entry.id] = npos;
+        }
+        heap_.clear();
+    }
+
+    // push adds id to the heap ordered by key and then by tie.
+    void push(std::uint32_t id, double key, double tie)
+    {
+        heap_.emplace_back(Entry{key, tie, id});
+        positions_[id] = heap_.size()-1;
+        sift_up(heap_.size()-1);
+    }
+
+    // decrease lowers the key of id which must be in the heap.
+    void decrease(std::uint32_t id, double key, double tie)
+    {
+        auto i = positions_[id];
+        heap_[i].key = key;
+        heap_[i].tie = tie;
+        sift_up(i);
+    }
+
+    // pop removes and returns the id with the smallest key.
+    std::uint32_t pop()
+    {
+        auto id = heap_.front().id;
+        positions_[id] = npos;
+        heap_.front() = heap_.back();
+        heap_.pop_back();
+        if (!heap_.empty()) {
+            positions_[heap_.front().id] = 0;
+            sift_down(0);
+        }
+        return id;
+    }
+
+  private:
+    static constexpr std::size_t npos = SIZE_MAX;
+
+    struct Entry
+    {
+        double key;
+        double tie;
+        std::uint32_t id;
+
+        bool operator<(const Entry& rhs) const
+        {
+            return key < rhs.key || (key == rhs.key && tie < rhs.tie);
+        }
+    };
+
+    // place stores entry at i and records its position.
+    void place(std::size_t i, const Entry& entry)
+    {
+        heap_[i] = entry;
+        positions_[entry.id] = i;
+    }
+
+    void sift_up(std::size_t i)
+    {
+        auto entry = heap_[i];
+        while (i > 0 && entry < heap_[(i-1)/2]) {
+            place(i, heap_[(i-1)/2]);
+            i = (i-1)/2;
+        }
+        place(i, entry);
+    }
+
+    void sift_down(std::size_t i)
+    {
+        auto entry = heap_[i];
+        for (auto child = 2*i+1; child < heap_.size(); child = 2*i+1) {
+            if (child+1 < heap_.size() && heap_[child+1] < heap_[child]) {
+                ++child;
+            }
+            if (!(heap_[child] < entry)) {
+                break;
+            }
+            place(i, heap_[child]);
+            i = child;
+        }
+        place(i, entry);
+    }
+
+    std::vector<Entry> heap_;
+    std::vector<std::size_t> positions_;  // Index of id in heap_ or npos.
+};
+
+// UnitCost is the substitution cost when every edit costs the same.
+struct UnitCost
+{
+    double operator()(std::size_t pos, char from, char to) const
+    {
+        return 1.0;
+    }
+};
+
+// WordGraphSearch answers shortest path queries over a WordGraph.
+//
+// The state of a breadth first search is held in arrays indexed by id which
+// are allocated once and reused by every query.  Rather than clearing the
+// arrays, each query increments an epoch and an entry is valid only when it
+// is stamped with the current epoch.  A search is not thread safe, but any
+// number of searches may share one graph.
+class WordGraphSearch
+{
+  public:
+    explicit WordGraphSearch(const WordGraph& graph)
+        : graph_(graph)
+        , stamps_(graph.num_words(), 0)
+        , parents_(graph.num_words())
+        , costs_(graph.num_words())
+        , open_(graph.num_words())
+    {
+        queue_.reserve(graph.num_words());
+    }
+
+    // shortest_path returns the shortest path of one-character
+    // transformations from start to end or the empty path.
+    std::vector<std::string> shortest_path(std::string_view start,
+                                           std::string_view end)
+    {
+        std::vector<std::string> path;
+        auto s = graph_.id(start), e = graph_.id(end);
+        if (!s || !e) {
+            return path;  // Both words must be in the dictionary.
+        }
+        if (search(*s, *e)) {
+            path = rebuild_path(*s, *e);
+        }
+        return path;
+    }
+
+    // shortest_path_astar returns the path from start to end whose sum of
+    // substitution costs is smallest or the empty path.
+    //
+    // cost(pos, from, to) is the cost of replacing the character from with
+    // the character to at position pos and must be at least min_cost.  The
+    // search is guided by the number of characters which differ from end
+    // times min_cost, which never overestimates the remaining cost.
+    template <typename CostFn=UnitCost>
+    std::vector<std::string> shortest_path_astar(std::string_view start,
+                                                 std::string_view end,
+                                                 CostFn cost=CostFn{},
+                                                 double min_cost=1.0)
+    {
+        std::vector<std::string> path;
+        auto s = graph_.id(start), e = graph_.id(end);
+        if (!s || !e || start.size() != end.size()) {
+            return path;  // Both words must be in the dictionary.
+        }
+
+        // heuristic is min_cost times the Hamming distance to end.
+        auto heuristic = [min_cost, end](std::string_view word) {
+            std::size_t ndiff = 0;
+            for (std::size_t ii = 0; ii < word.size(); ++ii) {
+                ndiff += word[ii] != end[ii];
+            }
+            return min_cost*ndiff;
+        };
+
+        next_epoch();
+        open_.clear();
+        stamps_[*s] = epoch_;
+        parents_[*s] = *s;
+        costs_[*s] = 0.0;
+        open_.push(*s, heuristic(start), 0.0);
+
+        while (!open_.empty()) {
+            auto v = open_.pop();
+            if (v == *e) {
+                return rebuild_path(*s, *e);
+            }
+            auto word = graph_.word(v);
+            for (auto p = graph_.neighbors_begin(v);
+                    p != graph_.neighbors_end(v); ++p) {
+                // Find the position of the single substitution.
+                auto next_word = graph_.word(*p);
+                std::size_t pos = 0;
+                while (word[pos] == next_word[pos]) {
+                    ++pos;
+                }
+                auto next_cost =
+                    costs_[v] + cost(pos, word[pos], next_word[pos]);
+
+                // Since the heuristic is consistent, a word which has left
+                // the open set already has its lowest cost.
+                bool discovered = stamps_[*p] == epoch_;
+                if (discovered
+                    && (!open_.contains(*p) || next_cost >= costs_[*p])) {
+                    continue;
+                }
+                stamps_[*p] = epoch_;
+                parents_[*p] = v;
+                costs_[*p] = next_cost;
+                // Break ties in favor of words closer to end.
+                auto h = heuristic(next_word);
+                if (discovered) {
+                    open_.decrease(*p, next_cost+h, h);
+                }
+                else {
+                    open_.push(*p, next_cost+h, h);
+                }
+            }
+        }
+        return path;
+    }
+
+  private:
+    // rebuild_path steps backwards through parents from e to s.
+    std::vector<std::string> rebuild_path(std::uint32_t s, std::uint32_t e)
+    {
+        std::vector<std::string> path;
+        for (auto v = e; v != s; v = parents_[v]) {
+            path.emplace_back(graph_.word(v));
+        }
+        path.emplace_back(graph_.word(s));
+        std::reverse(std::begin(path), std::end(path));
+        return path;
+    }
+
+    // search runs breadth first search from s until e is discovered.
+    bool search(std::uint32_t s, std::uint32_t e)
+    {
+        next_epoch();
+        queue_.clear();
+        discover(s, s);
+        for (std::size_t head = 0; head < queue_.size(); ++head) {
+            auto v = queue_[head];
+            if (v == e) {
+                return true;
+            }
+            for (auto p = graph_.neighbors_begin(v);
+                    p != graph_.neighbors_end(v); ++p) {
+                if (stamps_[*p] != epoch_) {
+                    discover(*p, v);
+                }
+            }
+        }
+        return false;
+    }
+
+    // discover marks v as discovered from parent and enqueues v.
+    void discover(std::uint32_t v, std::uint32_t parent)
+    {
+        stamps_[v] = epoch_;
+        parents_[v] = parent;
+        queue_.emplace_back(v);
+    }
+
+    // next_epoch advances the epoch, clearing stamps only on wraparound.
+    void next_epoch()
+    {
+        if (++epoch_ == 0) {
+            std::fill(std::begin(stamps_), std::end(stamps_), 0);
+            epoch_ = 1;
+        }
+    }
+
+    const WordGraph& graph_;
+    std::uint32_t epoch_{0};
+    std::vector<std::uint32_t> stamps_;   // Epoch when id was discovered.
+    std::vector<std::uint32_t> parents_;  // Parent of id in search tree.
+    std::vector<std::uint32_t> queue_;    // Queue of ids to visit.
+    std::vector<double> costs_;           // Cost of path from start to id.
+    IndexedMinHeap open_;                 // Open set of A* search.
+};
+
+// AtomicBitmap is a bitmap whose bits may be set concurrently.
+class AtomicBitmap
+{
+  public:
+    explicit AtomicBitmap(std::size_t n)
+        : words_((n+63)/64)
+    { }
+
+    // test returns true when bit i is set.
+    bool test(std::size_t i) const
+    {
+        return words_[i/64].load(std::memory_order_relaxed) & mask(i);
+    }
+
+    // set sets bit i and returns true when this call changed it from 0 to 1.
+    bool set(std::size_t i)
+    {
+        auto prev = words_[i/64].fetch_or(mask(i), std::memory_order_relaxed);
+        return !(prev & mask(i));
+    }
+
+    // clear sets every bit to 0.
+    void clear()
+    {
+        for (auto& w : words_) {
+            w.store(0, std::memory_order_relaxed);
+        }
+    }
+
+  private:
+    static std::uint64_t mask(std::size_t i)
+    {
+        return std::uint64_t{1} << (i%64);
+    }
+
+    std::vector<std::atomic<std::uint64_t>> words_;
+};
+
+// parallel_for invokes fn(first, last, tid) on nthreads threads which
+// together cover [0, n) and returns when every thread is done.
+template <typename Fn>
+void
+parallel_for(std::size_t n, std::size_t nthreads, Fn&& fn)
+{
+    std::size_t chunk = (n+nthreads-1)/nthreads;
+    std::vector<std::thread> threads;
+    for (std::size_t tid = 1; tid < nthreads; ++tid) {
+        auto first = std::min(n, tid*chunk), last = std::min(n, first+chunk);
+        threads.emplace_back([&fn, first, last, tid]() {
+            fn(first, last, tid);
+        });
+    }
+    fn(0, std::min(n, chunk), 0);  // Calling thread takes the first chunk.
+    for (auto& t : threads) {
+        t.join();
+    }
+}
+
+// BfsTree holds the distance and parent of every word from a root word.
+struct BfsTree
+{
+    // unreachable is the distance and parent of words not reachable.
+    static constexpr std::uint32_t unreachable = UINT32_MAX;
+
+    std::vector<std::uint32_t> distances;
+    std::vector<std::uint32_t> parents;  // By convention, root is its own.
+};
+
+// parallel_bfs returns the breadth first search tree of every word which is
+// reachable from root using level synchronous search on nthreads threads.
+//
+// Each level is expanded either top-down, where the frontier claims its
+// unvisited neighbors, or bottom-up, where every unvisited word looks for a
+// neighbor in the frontier and stops at the first one found.  Bottom-up is
+// cheaper once the frontier holds a large share of the remaining edges,
+// which is decided with the heuristic of (Beamer et al., 2012).
+BfsTree
+parallel_bfs(const WordGraph& graph, std::uint32_t root,
+             std::size_t nthreads=std::thread::hardware_concurrency())
+{
+    // Tuning parameters suggested by Beamer et al.
+    static constexpr std::uint64_t alpha = 14, beta = 24;
+
+    const std::uint32_t n = graph.num_words();
+    nthreads = std::max<std::size_t>(nthreads, 1);
+    auto degree = [&graph](std::uint32_t v) -> std::uint64_t {
+        return graph.neighbors_end(v) - graph.neighbors_begin(v);
+    };
+
+    BfsTree tree{std::vector<std::uint32_t>(n, BfsTree::unreachable),
+                 std::vector<std::uint32_t>(n, BfsTree::unreachable)};
+    AtomicBitmap visited(n), in_frontier(n);
+    visited.set(root);
+    tree.distances[root] = 0;
+    tree.parents[root] = root;
+
+    std::vector<std::uint32_t> frontier{root};
+    std::vector<std::vector<std::uint32_t>> next(nthreads);
+    std::uint64_t unexplored_edges = graph.num_edges() - degree(root);
+    bool bottom_up = false;
+
+    for (std::uint32_t level = 1; !frontier.empty(); ++level) {
+        // Choose the direction of expansion for this level.
+        std::uint64_t frontier_edges = 0;
+        for (const auto v : frontier) {
+            frontier_edges += degree(v);
+        }
+        if (!bottom_up && frontier_edges > unexplored_edges/alpha) {
+            bottom_up = true;
+        }
+        else if (bottom_up && frontier.size() < n/beta) {
+            bottom_up = false;
+        }
+
+        // discover records u discovered from v by the thread tid.
+        auto discover = [&](std::uint32_t u, std::uint32_t v,
+                            std::size_t tid) {
+            tree.distances[u] = level;
+            tree.parents[u] = v;
+            next[tid].emplace_back(u);
+        };
+
+        if (bottom_up) {
+            in_frontier.clear();
+            for (const auto v : frontier) {
+                in_frontier.set(v);
+            }
+            // Each unvisited word is examined by exactly one thread.
+            parallel_for(n, nthreads,
+                [&](std::size_t first, std::size_t last, std::size_t tid) {
+                    for (auto u = first; u < last; ++u) {
+                        if (visited.test(u)) {
+                            continue;
+                        }
+                        for (auto p = graph.neighbors_begin(u);
+                                p != graph.neighbors_end(u); ++p) {
+                            if (in_frontier.test(*p)) {
+                                visited.set(u);
+                                discover(u, *p, tid);
+                                break;
+                            }
+                        }
+                    }
+                });
+        }
+        else {
+            // Threads race to claim each neighbor; only one set succeeds.
+            parallel_for(frontier.size(), nthreads,
+                [&](std::size_t first, std::size_t last, std::size_t tid) {
+                    for (auto i = first; i < last; ++i) {
+                        auto v = frontier[i];
+                        for (auto p = graph.neighbors_begin(v);
+                                p != graph.neighbors_end(v); ++p) {
+                            if (!visited.test(*p) && visited.set(*p)) {
+                                discover(*p, v, tid);
+                            }
+                        }
+                    }
+                });
+        }
+
+        // Gather the next frontier from every thread.
+        frontier.clear();
+        for (auto& words : next) {
+            for (const auto u : words) {
+                unexplored_edges -= degree(u);
+            }
+            frontier.insert(std::end(frontier),
+                            std::begin(words), std::end(words));
+            words.clear();
+        }
+    }
+
+    return tree;
+}
+
+
 // stepword_chain returns the shortest path of one-character transformations
 // from start to end consisting only of valid_words.
 std::vector<std::string>
@@ -26,51 +907,27 @@ stepword_chain(const std::string& start,
     std::unordered_map<std::string, std::string> parents;
     parents[start] = start; // By convention, start is mapped to itself.
 
-    // visit_states records the state of each valid word.
-    enum class VisitState { Undiscovered, Discovered, Visited };
-    std::unordered_map<std::string, VisitState> visit_states;
-
-    // is_one_character_different is true when s1 and s2 differ by one char.
-    auto is_one_character_different =
-        [](const std::string& s1, const std::string& s2) -> bool {
-        if (s1.size() != s2.size()) {
-            return false;
-        }
-        int cnt_diff = 0;
-        for (std::size_t ii = 0; ii < s1.size(); ++ii) {
-            if (s1[ii] != s2[ii] && ++cnt_diff > 1) {
-                break;
-            }
-        }
-        return cnt_diff == 1;
-    };
+    // index discovers edges by bucket lookup rather than comparing a word
+    // to every other word in the dictionary.
+    const WildcardIndex index(valid_words);
 
     while (!nodes_to_visit.empty()) {
         auto word = nodes_to_visit.front();
         nodes_to_visit.pop();
-        visit_states[word] = VisitState::Visited;
-
-        for (const auto& next_word : valid_words) {
-            // Skip words which have already been visited since in a breadth
-            // first search they are part of a shorter transformation sequence.
-            // NOTE(mmorais): Not exactly sure about the criteria here.
-            // Should we exclude Discovered or Visited or something else?
-            auto next_word_state = visit_states.find(next_word);
-            if (next_word_state != visit_states.end()
-                && next_word_state->second == VisitState::Visited) {
-                continue;
-            }
 
-            // Skip words if more than one-character edit is required.
-            if (!is_one_character_different(word, next_word)) {
-                continue;
+        index.for_each_neighbor(word, [&](const std::string& next_word) {
+            // Skip words which have already been discovered since in a
+            // breadth first search they are part of a transformation
+            // sequence which is no longer than the one through word.
+            if (parents.find(next_word) != std::end(parents)) {
+                return;
             }
 
             // Set the parent of the next_word to word and add next_word to
             // the list of nodes to visit to continue the sequence.
             parents[next_word] = word;
             nodes_to_visit.emplace(next_word);
-        }
+        });
     }
 
     // Step backwards through the transformation from end back to start.
@@ -89,6 +946,122 @@ stepword_chain(const std::string& start,
 }
 
 
+// stepword_chain_bidirectional returns the same shortest path length as
+// stepword_chain by searching from start and end simultaneously.
+std::vector<std::string>
+stepword_chain_bidirectional(const std::string& start,
+                             const std::string& end,
+                             const std::vector<std::string>& valid_words)
+{
+    // Edge cases which do not require a search.
+    if (start == end) {
+        return {start};
+    }
+    if (std::find(std::begin(valid_words), std::end(valid_words), end)
+            == std::end(valid_words)) {
+        return {};
+    }
+
+    const WildcardIndex index(valid_words);
+
+    // Side 0 searches forward from start and side 1 backward from end.
+    // Each side holds the words discovered at its deepest level and a map
+    // from each discovered word to the word which discovered it.
+    std::vector<std::string> frontiers[2]{{start}, {end}};
+    std::unordered_map<std::string, std::string> parents[2];
+    parents[0][start] = start;
+    parents[1][end] = end;
+
+    // meet holds the first edge (word, next_word) which joins both sides.
+    std::optional<std::pair<std::string, std::string>> meet;
+
+    while (!meet && !frontiers[0].empty() && !frontiers[1].empty()) {
+        // Expand one level of the smaller frontier, which keeps the number
+        // of words discovered close to the minimum needed to meet.
+        auto side = frontiers[0].size() <= frontiers[1].size() ? 0 : 1;
+        auto& own = parents[side];
+        const auto& other = parents[1-side];
+
+        std::vector<std::string> next_frontier;
+        for (const auto& word : frontiers[side]) {
+            index.for_each_neighbor(word, [&](const std::string& next_word) {
+                if (meet || own.find(next_word) != std::end(own)) {
+                    return;
+                }
+                // Since every level of the other side is complete, the first
+                // edge which reaches the other side is on a shortest path.
+                if (other.find(next_word) != std::end(other)) {
+                    meet.emplace(word, next_word);
+                    return;
+                }
+                own[next_word] = word;
+                next_frontier.emplace_back(next_word);
+            });
+            if (meet) {
+                break;
+            }
+        }
+        frontiers[side] = std::move(next_frontier);
+
+        // Orient the meeting edge from the start side to the end side.
+        if (meet && side == 1) {
+            std::swap(meet->first, meet->second);
+        }
+    }
+
+    std::vector<std::string> shortest_path;
+    if (!meet) {
+        return shortest_path;
+    }
+
+    // Step backwards from the meeting edge to start, then forwards to end.
+    for (auto w = meet->first; ; w = parents[0][w]) {
+        shortest_path.emplace_back(w);
+        if (w == start) {
+            break;
+        }
+    }
+    std::reverse(std::begin(shortest_path), std::end(shortest_path));
+    for (auto w = meet->second; ; w = parents[1][w]) {
+        shortest_path.emplace_back(w);
+        if (w == end) {
+            break;
+        }
+    }
+
+    return shortest_path;
+}
+
+
+// stepword_chain_astar returns the shortest path from start to end found
+// using A* search with the given substitution cost.  As for stepword_chain,
+// start need not be in valid_words.
+//
+// The WordGraph is built for this one query, which costs far more than the
+// search itself.  To answer many queries against one dictionary, build the
+// WordGraph once and call WordGraphSearch::shortest_path_astar instead.
+template <typename CostFn=UnitCost>
+std::vector<std::string>
+stepword_chain_astar(const std::string& start,
+                     const std::string& end,
+                     const std::vector<std::string>& valid_words,
+                     CostFn cost=CostFn{},
+                     double min_cost=1.0)
+{
+    if (start == end) {
+        return {start};
+    }
+
+    // Adding start to the graph does not shorten any path between other
+    // words, since a path through start can begin at start instead.
+    auto words = valid_words;
+    words.emplace_back(start);
+    const WordGraph graph(words);
+    WordGraphSearch search(graph);
+    return search.shortest_path_astar(start, end, cost, min_cost);
+}
+
+
 TEST_CASE("examples", "[stepword]")
 {
     struct test_case
@@ -119,6 +1092,32 @@ TEST_CASE("examples", "[stepword]")
             "cat",
             {"dog", "dot", "tod", "mat", "cat"},
             {}
+        },
+        // The start need not be a valid word.
+        test_case{
+            "dig",
+            "cat",
+            {"dog", "dot", "dat", "cat"},
+            {"dig", "dog", "dot", "dat", "cat"}
+        },
+        test_case{
+            "dig",
+            "dig",
+            {"dog"},
+            {"dig"}
+        },
+        // Words may contain any character, including '*'.
+        test_case{
+            "a*",
+            "*b",
+            {"a*", "*b", "xy"},
+            {}
+        },
+        test_case{
+            "a*",
+            "*b",
+            {"a*", "*b", "ab"},
+            {"a*", "ab", "*b"}
         }
     };
 
@@ -127,5 +1126,282 @@ TEST_CASE("examples", "[stepword]")
         auto rcv_path = stepword_chain(c.start, c.end, c.valid_words);
 
         REQUIRE(rcv_path == c.expected_path);
+
+        rcv_path = stepword_chain_bidirectional(c.start, c.end,
+                                                c.valid_words);
+        REQUIRE(rcv_path == c.expected_path);
+
+        rcv_path = stepword_chain_astar(c.start, c.end, c.valid_words);
+        REQUIRE(rcv_path == c.expected_path);
+    }
+}
+
+TEST_CASE("wildcard index", "[stepword]")
+{
+    std::mt19937 gen{std::random_device{}()};
+    const std::string alphabet("abcd*");
+    std::uniform_int_distribution<std::size_t> letter(0, alphabet.size()-1);
+    std::uniform_int_distribution<std::size_t> length(2, 4);
+
+    // Random words over a small alphabet produce a dense graph.
+    std::vector<std::string> words(200);
+    for (auto& w : words) {
+        w.resize(length(gen));
+        for (auto& c : w) {
+            c = alphabet[letter(gen)];
+        }
+    }
+    std::sort(std::begin(words), std::end(words));
+    words.erase(std::unique(std::begin(words), std::end(words)),
+                std::end(words));
+
+    const WildcardIndex index(words);
+    for (const auto& w : words) {
+        std::vector<std::string> expected, rcv;
+        std::copy_if(std::begin(words), std::end(words),
+                     std::back_inserter(expected),
+                     [&w](const std::string& v) {
+                         return is_one_character_different(w, v);
+                     });
+        index.for_each_neighbor(w, [&rcv](const std::string& v) {
+            rcv.emplace_back(v);
+        });
+        std::sort(std::begin(rcv), std::end(rcv));
+        CAPTURE(w);
+        REQUIRE(rcv == expected);
+    }
+}
+
+TEST_CASE("word graph", "[stepword]")
+{
+    std::mt19937 gen{std::random_device{}()};
+    std::uniform_int_distribution<int> letter('a', 'f');
+
+    // Random words over a small alphabet produce a dense graph.
+    std::vector<std::string> words(300);
+    for (auto& w : words) {
+        w.resize(3);
+        for (auto& c : w) {
+            c = static_cast<char>(letter(gen));
+        }
+    }
+
+    const WordGraph graph(words);
+    REQUIRE(graph.num_words() <= words.size());
+
+    // Reload the graph from a stream and view it in place.
+    std::stringstream ss;
+    graph.save(ss);
+    auto loaded = WordGraph::load(ss);
+    std::vector<std::uint64_t> mapped(graph.size()/sizeof(std::uint64_t));
+    std::memcpy(mapped.data(), graph.data(), graph.size());
+    auto viewed = WordGraph::view(
+        reinterpret_cast<const char*>(mapped.data()), graph.size());
+    REQUIRE(loaded.num_edges() == graph.num_edges());
+    REQUIRE(viewed.num_edges() == graph.num_edges());
+
+    // Corrupt buffers are rejected by view and load alike.  The 32 byte
+    // header holding magic, nwords, nedges and ntext is followed by the
+    // 32-bit row offsets.
+    auto require_rejected = [&mapped, &graph](std::size_t pos,
+                                              std::uint32_t value) {
+        auto buf = mapped;
+        auto data = reinterpret_cast<char*>(buf.data());
+        std::memcpy(data+pos, &value, sizeof(value));
+        CAPTURE(pos, value);
+        REQUIRE_THROWS_AS(WordGraph::view(data, graph.size()),
+                          WordGraphError);
+        std::stringstream corrupt(std::string(data, graph.size()));
+        REQUIRE_THROWS_AS(WordGraph::load(corrupt), WordGraphError);
+    };
+    require_rejected(0, 0);                         // magic
+    require_rejected(12, 1);                        // nwords >= 2^32
+    require_rejected(20, 1);                        // nedges >= 2^32
+    require_rejected(28, 1);                        // ntext >= 2^32
+    require_rejected(32, 1);                        // rows[0] != 0
+    require_rejected(36, UINT32_MAX);               // rows not monotone
+    require_rejected(32+4*graph.num_words(), UINT32_MAX);  // rows past end
+    REQUIRE(graph.num_edges() > 0);
+    auto cols = 32 + (4*(graph.num_words()+1)+7)/8*8;
+    require_rejected(cols, graph.num_words());      // neighbor past end
+    require_rejected(8, UINT32_MAX-1);              // nwords past stream
+
+    // A neighbor must be one substitution away, so a word may not be its
+    // own neighbor.
+    std::uint32_t owner = 0;
+    while (graph.neighbors_begin(owner) == graph.neighbors_end(owner)) {
+        ++owner;
+    }
+    require_rejected(cols, owner);                  // neighbor not adjacent
+
+    // is_valid_path is true when path is a chain of valid words.
+    auto is_valid_path = [&words](const std::vector<std::string>& path) {
+        for (std::size_t ii = 0; ii < path.size(); ++ii) {
+            if (std::find(std::begin(words), std::end(words), path[ii])
+                    == std::end(words)) {
+                return false;
+            }
+            if (ii > 0 && !is_one_character_different(path[ii-1], path[ii])) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    WordGraphSearch search(graph), search_loaded(loaded),
+                    search_viewed(viewed);
+    std::uniform_int_distribution<std::size_t> pick(0, words.size()-1);
+    for (std::size_t repeat = 0; repeat < 200; ++repeat) {
+        const auto& start = words[pick(gen)];
+        const auto& end = words[pick(gen)];
+        auto expected = stepword_chain(start, end, words);
+        auto rcv = search.shortest_path(start, end);
+        CAPTURE(start, end, expected, rcv);
+        REQUIRE(rcv.size() == expected.size());
+        REQUIRE(is_valid_path(rcv));
+        if (!rcv.empty()) {
+            REQUIRE(rcv.front() == start);
+            REQUIRE(rcv.back() == end);
+        }
+        REQUIRE(search_loaded.shortest_path(start, end) == rcv);
+        REQUIRE(search_viewed.shortest_path(start, end) == rcv);
+
+        auto rcv_bidirectional =
+            stepword_chain_bidirectional(start, end, words);
+        CAPTURE(rcv_bidirectional);
+        REQUIRE(rcv_bidirectional.size() == expected.size());
+        REQUIRE(is_valid_path(rcv_bidirectional));
+        if (!rcv_bidirectional.empty()) {
+            REQUIRE(rcv_bidirectional.front() == start);
+            REQUIRE(rcv_bidirectional.back() == end);
+        }
+    }
+
+    // Words which are not in the dictionary have no path.
+    REQUIRE(search.shortest_path("zzz", words[0]).empty());
+    REQUIRE_THROWS_AS(WordGraph::view(ss.str().data(), 8), WordGraphError);
+}
+
+TEST_CASE("parallel bfs", "[stepword]")
+{
+    std::mt19937 gen{std::random_device{}()};
+    std::uniform_int_distribution<int> letter('a', 'h');
+
+    // Mix a dense component of short words with sparse longer words.
+    std::vector<std::string> words(2000);
+    for (std::size_t ii = 0; ii < words.size(); ++ii) {
+        words[ii].resize(ii%2 == 0 ? 3 : 5);
+        for (auto& c : words[ii]) {
+            c = static_cast<char>(letter(gen));
+        }
+    }
+    const WordGraph graph(words);
+
+    // Compute distances using a serial breadth first search.
+    auto serial_bfs = [&graph](std::uint32_t root) {
+        std::vector<std::uint32_t> distances(graph.num_words(),
+                                             BfsTree::unreachable);
+        std::queue<std::uint32_t> nodes_to_visit;
+        nodes_to_visit.emplace(root);
+        distances[root] = 0;
+        while (!nodes_to_visit.empty()) {
+            auto v = nodes_to_visit.front();
+            nodes_to_visit.pop();
+            for (auto p = graph.neighbors_begin(v);
+                    p != graph.neighbors_end(v); ++p) {
+                if (distances[*p] == BfsTree::unreachable) {
+                    distances[*p] = distances[v]+1;
+                    nodes_to_visit.emplace(*p);
+                }
+            }
+        }
+        return distances;
+    };
+
+    std::uniform_int_distribution<std::uint32_t> pick(0, graph.num_words()-1);
+    for (std::size_t nthreads : {1, 2, 4, 8}) {
+        auto root = pick(gen);
+        auto expected = serial_bfs(root);
+        auto rcv = parallel_bfs(graph, root, nthreads);
+        CAPTURE(nthreads, root);
+        REQUIRE(rcv.distances == expected);
+
+        // Every parent must be a neighbor one level closer to root.
+        REQUIRE(rcv.parents[root] == root);
+        for (std::uint32_t v = 0; v < graph.num_words(); ++v) {
+            if (v == root || expected[v] == BfsTree::unreachable) {
+                REQUIRE(rcv.parents[v] == (v == root ? root
+                                                     : BfsTree::unreachable));
+                continue;
+            }
+            auto parent = rcv.parents[v];
+            REQUIRE(expected[parent]+1 == expected[v]);
+            REQUIRE(std::find(graph.neighbors_begin(v), graph.neighbors_end(v),
+                              parent) != graph.neighbors_end(v));
+        }
+    }
+}
+
+TEST_CASE("astar", "[stepword]")
+{
+    std::mt19937 gen{std::random_device{}()};
+    std::uniform_int_distribution<int> letter('a', 'f');
+
+    // Random words over a small alphabet produce a dense graph.
+    std::vector<std::string> words(400);
+    for (auto& w : words) {
+        w.resize(4);
+        for (auto& c : w) {
+            c = static_cast<char>(letter(gen));
+        }
+    }
+    const WordGraph graph(words);
+    WordGraphSearch search(graph);
+
+    // Substitutions are cheaper at the end of a word and between nearby
+    // letters, but never cost less than 1.
+    auto weighted_cost = [](std::size_t pos, char from, char to) {
+        return 1.0 + (3-pos) + std::abs(from-to);
+    };
+    auto path_cost = [&weighted_cost](const std::vector<std::string>& path) {
+        double total = 0.0;
+        for (std::size_t ii = 1; ii < path.size(); ++ii) {
+            std::size_t pos = 0;
+            while (path[ii-1][pos] == path[ii][pos]) {
+                ++pos;
+            }
+            total += weighted_cost(pos, path[ii-1][pos], path[ii][pos]);
+        }
+        return total;
+    };
+
+    std::uniform_int_distribution<std::size_t> pick(0, words.size()-1);
+    for (std::size_t repeat = 0; repeat < 200; ++repeat) {
+        const auto& start = words[pick(gen)];
+        const auto& end = words[pick(gen)];
+        CAPTURE(start, end);
+
+        // Unit costs yield a path as short as breadth first search.
+        auto expected = search.shortest_path(start, end);
+        auto rcv = search.shortest_path_astar(start, end);
+        CAPTURE(expected, rcv);
+        REQUIRE(rcv.size() == expected.size());
+        if (!rcv.empty()) {
+            REQUIRE(rcv.front() == start);
+            REQUIRE(rcv.back() == end);
+        }
+        for (std::size_t ii = 1; ii < rcv.size(); ++ii) {
+            REQUIRE(is_one_character_different(rcv[ii-1], rcv[ii]));
+        }
+
+        // Weighted costs match Dijkstra, which is A* with zero heuristic.
+        auto dijkstra = search.shortest_path_astar(start, end,
+                                                   weighted_cost, 0.0);
+        auto weighted = search.shortest_path_astar(start, end,
+                                                   weighted_cost, 1.0);
+        CAPTURE(dijkstra, weighted);
+        REQUIRE(weighted.empty() == expected.empty());
+        REQUIRE(path_cost(weighted) == Approx(path_cost(dijkstra)));
+        REQUIRE(path_cost(weighted) <= path_cost(expected));
     }
 }
@@ -1,40 +1,285 @@
 #include <algorithm>
+#include <array>
+#include <charconv>
+#include <cmath>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
 #include <iostream>
 #include <istream>
 #include <iterator>
+#include <map>
 #include <numeric>
 #include <random>
 #include <sstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
-// Let Catch provide main().
+// Let Catch provide main() and benchmarks.
 #define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
 #include "catch2/catch.hpp"
 
-// randstream returns random sample of k elements from an unbounded stream.
+// splitmix64 returns the next output of the SplitMix64 generator, which is
+// used to expand a single seed into the state of a larger generator.
+constexpr std::uint64_t
+splitmix64(std::uint64_t& x)
+{
+    std::uint64_t z = (x += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+}
+
+// rotl rotates x left by k bits.
+constexpr std::uint64_t
+rotl(std::uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+// Xoshiro256pp is the xoshiro256++ generator of (Blackman and Vigna, 2021).
+//
+// long_jump advances the generator by 2^192 outputs, so a single seed yields
+// reproducible streams which do not overlap in practice.
+class Xoshiro256pp
+{
+  public:
+    using result_type = std::uint64_t;
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return ~result_type{0}; }
+
+    explicit Xoshiro256pp(std::uint64_t seed=0)
+    {
+        for (auto& x : s_) {
+            x = splitmix64(seed);
+        }
+    }
+
+    // stream returns the generator for stream id of the given seed.
+    static Xoshiro256pp stream(std::uint64_t seed, std::size_t id)
+    {
+        Xoshiro256pp gen(seed);
+        for (std::size_t i = 0; i < id; ++i) {
+            gen.long_jump();
+        }
+        return gen;
+    }
+
+    result_type operator()()
+    {
+        auto result = rotl(s_[0] + s_[3], 23) + s_[0];
+        auto t = s_[1] << 17;
+        s_[2] ^= s_[0];
+        s_[3] ^= s_[1];
+        s_[1] ^= s_[2];
+        s_[0] ^= s_[3];
+        s_[2] ^= t;
+        s_[3] = rotl(s_[3], 45);
+        return result;
+    }
+
+    void long_jump()
+    {
+        static constexpr std::uint64_t poly[] = {
+            0x76e15d3efefdcbbf, 0xc5004e441c522fb3,
+            0x77710069854ee241, 0x39109bb02acbe635
+        };
+        advance(poly);
+    }
+
+  private:
+    // advance multiplies the state by the jump polynomial poly.
+    void advance(const std::uint64_t (&poly)[4])
+    {
+        std::array<std::uint64_t, 4> s{};
+        for (const auto p : poly) {
+            for (int b = 0; b < 64; ++b) {
+                if (p & (std::uint64_t{1} << b)) {
+                    for (std::size_t i = 0; i < s.size(); ++i) {
+                        s[i] ^= s_[i];
+                    }
+                }
+                (*this)();
+            }
+        }
+        s_ = s;
+    }
+
+    std::array<std::uint64_t, 4> s_;
+};
+
+// A source provides the elements of a stream to a sampler through:
+// * bool next(T& x), which reads the next element into x and returns false
+//   when the stream has ended.
+// * std::size_t skip(std::size_t n), which discards up to n elements and
+//   returns the number discarded.
+// Decoupling the sampler from the source lets the same reservoir code run
+// over formatted text, raw binary arrays, or delimited text in memory.
+
+// IstreamSource reads elements from a stream using formatted extraction.
 template <typename T>
-std::vector<T>
-randstream(std::istream& is, std::size_t k=1)
+class IstreamSource
+{
+  public:
+    explicit IstreamSource(std::istream& is)
+        : is_(is)
+    { }
+
+    bool next(T& x)
+    {
+        return static_cast<bool>(is_ >> x);
+    }
+
+    std::size_t skip(std::size_t n)
+    {
+        T x;
+        std::size_t nskip = 0;
+        while (nskip < n && is_ >> x) {
+            ++nskip;
+        }
+        return nskip;
+    }
+
+  private:
+    std::istream& is_;
+};
+
+// BinarySource reads elements from a raw binary array of T in memory, such
+// as a memory mapped file.  Skipping is O(1).
+template <typename T>
+class BinarySource
+{
+  public:
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "elements must be trivially copyable");
+
+    BinarySource(const char* data, std::size_t size)
+        : first_(data)
+        , last_(data + size/sizeof(T)*sizeof(T))
+    { }
+
+    bool next(T& x)
+    {
+        if (first_ == last_) {
+            return false;
+        }
+        // Copy rather than cast since data need not be aligned.
+        std::memcpy(&x, first_, sizeof(T));
+        first_ += sizeof(T);
+        return true;
+    }
+
+    std::size_t skip(std::size_t n)
+    {
+        auto nskip = std::min<std::size_t>(n, (last_-first_)/sizeof(T));
+        first_ += nskip*sizeof(T);
+        return nskip;
+    }
+
+  private:
+    const char* first_;
+    const char* last_;
+};
+
+// DelimitedSource reads integers, one per line, from newline delimited text
+// in memory, such as a memory mapped file.
+//
+// Lines are found with memchr, which the C library implements with vector
+// instructions, and parsed with std::from_chars, which is independent of the
+// locale.  Lines end with "\n" or "\r\n".  Empty lines are ignored and
+// characters following the integer on a line are ignored.  As with formatted
+// extraction, the stream ends at the first line which does not start with an
+// integer, whether that line is reached by next or by skip.
+template <typename T>
+class DelimitedSource
 {
-    thread_local std::mt19937 gen{std::random_device{}()};
+  public:
+    static_assert(std::is_integral<T>::value, "elements must be integers");
+
+    DelimitedSource(const char* data, std::size_t size)
+        : first_(data)
+        , last_(data + size)
+    { }
+
+    bool next(T& x)
+    {
+        const char* eol;
+        if (!next_line(eol)) {
+            return false;
+        }
+        auto result = std::from_chars(first_, eol, x);
+        if (result.ec != std::errc{}) {
+            first_ = last_;  // End the stream at malformed input.
+            return false;
+        }
+        first_ = eol == last_ ? last_ : eol+1;
+        return true;
+    }
+
+    std::size_t skip(std::size_t n)
+    {
+        // Skipped lines are parsed too, so that the stream ends at the same
+        // malformed line as it would for next.
+        std::size_t nskip = 0;
+        T x;
+        while (nskip < n && next(x)) {
+            ++nskip;
+        }
+        return nskip;
+    }
 
+  private:
+    // next_line moves past empty lines and finds the end of the next line.
+    bool next_line(const char*& eol)
+    {
+        while (first_ != last_ && (*first_ == '\n' || is_crlf(first_))) {
+            ++first_;
+        }
+        if (first_ == last_) {
+            return false;
+        }
+        auto p = std::memchr(first_, '\n', last_-first_);
+        eol = p ? static_cast<const char*>(p) : last_;
+        return true;
+    }
+
+    // is_crlf is true when the carriage return at p ends an empty line.
+    bool is_crlf(const char* p) const
+    {
+        return *p == '\r' && (p+1 == last_ || p[1] == '\n');
+    }
+
+    const char* first_;
+    const char* last_;
+};
+
+// reservoir_sample returns random sample of k elements from source using
+// the random number generator gen.
+template <typename T, typename Source, typename Engine>
+std::vector<T>
+reservoir_sample(Source& source, std::size_t k, Engine& gen)
+{
     std::vector<T> samples;
     samples.reserve(k);
     T x;
 
     // Fill the reservoir with the first k samples.
-    while (is >> x) {
+    while (samples.size() < k && source.next(x)) {
         samples.emplace_back(x);
-        if (samples.size() == k) {
-            break;
-        }
     }
 
     // For each sample received after the reservoir is filled,
     // replace an existing sample with probability = 1/n.
     std::size_t n{k};
-    while (is >> x) {
+    while (source.next(x)) {
         ++n;
         std::uniform_int_distribution<std::size_t> dis(1, n); // [1, n]
         auto rind = dis(gen);
@@ -46,15 +291,683 @@ randstream(std::istream& is, std::size_t k=1)
     return samples;
 }
 
-TEST_CASE("chisq", "[randstream]")
+// reservoir_sample_l returns a random sample of k elements from source with
+// the same distribution as reservoir_sample, but rather than drawing a
+// random number for every element it draws the number of elements to skip
+// before the next replacement using Algorithm L of (Li, 1994).
+template <typename T, typename Source, typename Engine>
+std::vector<T>
+reservoir_sample_l(Source& source, std::size_t k, Engine& gen)
 {
-    using T = std::uint32_t;
+    std::vector<T> samples;
+    samples.reserve(k);
+    T x;
 
-    // Simulation parameters.
-    std::size_t k = 10; // Number of samples to return from each trial.
-    std::size_t n = 100; // Size of the stream.
-    std::size_t nrepeat = 10000; // Number of trials.
+    // Fill the reservoir with the first k samples.
+    while (samples.size() < k && source.next(x)) {
+        samples.emplace_back(x);
+    }
+    if (samples.size() < k || k == 0) {
+        return samples;
+    }
+
+    // uniform returns a random number from the open interval (0, 1).
+    std::uniform_real_distribution<double> udis(0.0, 1.0);
+    auto uniform = [&udis, &gen]() {
+        double u;
+        do {
+            u = udis(gen);
+        } while (u == 0.0);
+        return u;
+    };
+    std::uniform_int_distribution<std::size_t> kdis(0, k-1);
+
+    // w is the largest of k uniform random numbers, one per element of the
+    // reservoir, which shrinks each time an element is replaced.
+    double w = std::exp(std::log(uniform())/k);
+    while (true) {
+        // The number of elements until the next replacement is
+        // geometrically distributed with probability of success w.
+        double nskip = std::floor(std::log(uniform())/std::log1p(-w));
+        if (nskip >= static_cast<double>(SIZE_MAX)) {
+            break;  // No further element will be selected.
+        }
+        auto n = static_cast<std::size_t>(nskip);
+        if (source.skip(n) != n || !source.next(x)) {
+            break;
+        }
+        samples[kdis(gen)] = x;
+        w *= std::exp(std::log(uniform())/k);
+    }
+
+    return samples;
+}
+
+// randstream returns random sample of k elements from an unbounded stream
+// using the random number generator gen.
+template <typename T, typename Engine>
+std::vector<T>
+randstream(std::istream& is, std::size_t k, Engine& gen)
+{
+    IstreamSource<T> source(is);
+    return reservoir_sample<T>(source, k, gen);
+}
+
+// randstream returns random sample of k elements from an unbounded stream.
+template <typename T, typename Engine=std::mt19937>
+std::vector<T>
+randstream(std::istream& is, std::size_t k=1)
+{
+    thread_local Engine gen{std::random_device{}()};
+    return randstream<T>(is, k, gen);
+}
+
+// randstream_l returns random sample of k elements from an unbounded stream
+// using Algorithm L and the random number generator gen.
+template <typename T, typename Engine>
+std::vector<T>
+randstream_l(std::istream& is, std::size_t k, Engine& gen)
+{
+    IstreamSource<T> source(is);
+    return reservoir_sample_l<T>(source, k, gen);
+}
+
+// randstream_l returns random sample of k elements from an unbounded stream.
+template <typename T, typename Engine=std::mt19937>
+std::vector<T>
+randstream_l(std::istream& is, std::size_t k=1)
+{
+    thread_local Engine gen{std::random_device{}()};
+    return randstream_l<T>(is, k, gen);
+}
+
+// weighted_reservoir_sample returns random sample of k elements from source
+// without replacement, where each element is selected with probability
+// proportional to weight(x), using the random number generator gen.
+//
+// Each element is given the key u^(1/w) for uniform random number u and
+// the sample is the k elements with the largest keys (Efraimidis and
+// Spirakis, 2006).  Rather than drawing a key for every element, the
+// exponential jumps of A-ExpJ draw the total weight to skip before the next
+// element enters the sample, so random numbers are drawn and the heap of
+// keys is updated only when an element is accepted.  Elements with weight
+// <= 0 are never selected.
+template <typename T, typename Source, typename Weight, typename Engine>
+std::vector<T>
+weighted_reservoir_sample(Source& source, std::size_t k, Weight weight,
+                          Engine& gen)
+{
+    // Keys are kept as log(u)/w, which preserves their order and does not
+    // underflow for large weights.
+    using Entry = std::pair<double, T>;
+    std::vector<Entry> heap;  // Min-heap of keys.
+    heap.reserve(k);
+    auto greater = [](const Entry& a, const Entry& b) {
+        return a.first > b.first;
+    };
+
+    // uniform returns a random number from the open interval (0, 1).
+    std::uniform_real_distribution<double> udis(0.0, 1.0);
+    auto uniform = [&udis, &gen]() {
+        double u;
+        do {
+            u = udis(gen);
+        } while (u == 0.0);
+        return u;
+    };
+
+    // Fill the reservoir with the first k elements of positive weight.
+    T x;
+    while (heap.size() < k && source.next(x)) {
+        double w = weight(x);
+        if (w > 0.0) {
+            heap.emplace_back(std::log(uniform())/w, x);
+            std::push_heap(std::begin(heap), std::end(heap), greater);
+        }
+    }
+
+    if (heap.size() == k && k > 0) {
+        // The weight to skip before the next element enters the sample is
+        // log(r)/log(t), where t is the smallest key in the sample.
+        double jump = std::log(uniform())/heap.front().first;
+        while (source.next(x)) {
+            double w = weight(x);
+            if (w <= 0.0) {
+                continue;
+            }
+            jump -= w;
+            if (jump > 0.0) {
+                continue;
+            }
+
+            // Accept x with a key drawn uniformly from the keys in (t, 1]
+            // for an element of weight w, i.e. (t^w, 1)^(1/w).
+            double tw = std::exp(heap.front().first*w);
+            std::uniform_real_distribution<double> rdis(tw, 1.0);
+            double r = std::max(rdis(gen), tw);
+            std::pop_heap(std::begin(heap), std::end(heap), greater);
+            heap.back() = Entry(std::min(std::log(r)/w, 0.0), x);
+            std::push_heap(std::begin(heap), std::end(heap), greater);
+            jump = std::log(uniform())/heap.front().first;
+        }
+    }
+
+    std::vector<T> samples;
+    samples.reserve(heap.size());
+    for (const auto& entry : heap) {
+        samples.emplace_back(entry.second);
+    }
+    return samples;
+}
+
+// randstream_weighted returns random sample of k elements from an unbounded
+// stream, weighted by weight(x), using the random number generator gen.
+template <typename T, typename Weight, typename Engine>
+std::vector<T>
+randstream_weighted(std::istream& is, std::size_t k, Weight weight,
+                    Engine& gen)
+{
+    IstreamSource<T> source(is);
+    return weighted_reservoir_sample<T>(source, k, weight, gen);
+}
+
+// randstream_weighted returns random sample of k elements from an unbounded
+// stream, weighted by weight(x).
+template <typename T, typename Weight, typename Engine=std::mt19937>
+std::vector<T>
+randstream_weighted(std::istream& is, std::size_t k, Weight weight)
+{
+    thread_local Engine gen{std::random_device{}()};
+    return randstream_weighted<T>(is, k, weight, gen);
+}
+
+// Reservoir is a uniform random sample of up to k elements which records
+// the number of elements it has seen, so that reservoirs sampled from
+// disjoint parts of a stream can be merged into a sample of the whole.
+template <typename T>
+class Reservoir
+{
+  public:
+    explicit Reservoir(std::size_t k)
+        : k_(k)
+    {
+        samples_.reserve(k);
+    }
+
+    // add offers x to the reservoir using Algorithm R.
+    template <typename Engine>
+    void add(const T& x, Engine& gen)
+    {
+        ++count_;
+        if (samples_.size() < k_) {
+            samples_.emplace_back(x);
+            return;
+        }
+        std::uniform_int_distribution<std::uint64_t> dis(1, count_);
+        auto rind = dis(gen);
+        if (rind <= k_) {
+            samples_[rind-1] = x;
+        }
+    }
+
+    // merge replaces this reservoir with a uniform random sample of the
+    // elements seen by this reservoir and other.
+    //
+    // Each slot of the merged sample is filled from this reservoir with
+    // probability n1/(n1+n2), where n1 and n2 are the numbers of elements
+    // not yet accounted for, so the number of slots filled from each side
+    // follows the hypergeometric distribution of a sample of the union.
+    // The slots are then filled with a random subset of each side, which
+    // is itself a uniform sample of that side.
+    template <typename Engine>
+    void merge(const Reservoir& other, Engine& gen)
+    {
+        if (other.k_ != k_) {
+            throw std::invalid_argument("reservoirs differ in size");
+        }
+        std::uint64_t n1 = count_, n2 = other.count_;
+        std::size_t m = std::min<std::uint64_t>(k_, n1+n2);
+        std::size_t m1 = 0;
+        for (std::size_t ii = 0; ii < m; ++ii) {
+            std::uniform_int_distribution<std::uint64_t> dis(1, n1+n2);
+            if (dis(gen) <= n1) {
+                ++m1, --n1;
+            } else {
+                --n2;
+            }
+        }
+
+        std::vector<T> theirs(other.samples_);
+        partial_shuffle(samples_, m1, gen);
+        partial_shuffle(theirs, m-m1, gen);
+        samples_.resize(m1);
+        samples_.insert(std::end(samples_), std::begin(theirs),
+                        std::begin(theirs)+(m-m1));
+        count_ += other.count_;
+    }
+
+    std::size_t capacity() const { return k_; }
+    std::uint64_t count() const { return count_; }
+    const std::vector<T>& samples() const { return samples_; }
+
+  private:
+    // partial_shuffle moves a uniform random subset of m elements of xs to
+    // its front.
+    template <typename Engine>
+    static void partial_shuffle(std::vector<T>& xs, std::size_t m,
+                                Engine& gen)
+    {
+        for (std::size_t ii = 0; ii < m; ++ii) {
+            std::uniform_int_distribution<std::size_t> dis(ii, xs.size()-1);
+            std::swap(xs[ii], xs[dis(gen)]);
+        }
+    }
+
+    std::size_t k_;
+    std::uint64_t count_{0};
+    std::vector<T> samples_;
+};
+
+// parallel_reservoir_sample returns random sample of k elements from the
+// union of sources, sampling each source in its own thread with its own
+// stream of the generator seeded by seed, then merging the reservoirs.
+template <typename T, typename Source>
+std::vector<T>
+parallel_reservoir_sample(std::vector<Source>& sources, std::size_t k,
+                          std::uint64_t seed)
+{
+    std::vector<Reservoir<T>> reservoirs(sources.size(), Reservoir<T>(k));
+    std::vector<std::thread> threads;
+    threads.reserve(sources.size());
+    for (std::size_t id = 0; id < sources.size(); ++id) {
+        threads.emplace_back([&sources, &reservoirs, seed, id]() {
+            auto gen = Xoshiro256pp::stream(seed, id);
+            T x;
+            while (sources[id].next(x)) {
+                reservoirs[id].add(x, gen);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    auto gen = Xoshiro256pp::stream(seed, sources.size());
+    Reservoir<T> merged(k);
+    for (const auto& reservoir : reservoirs) {
+        merged.merge(reservoir, gen);
+    }
+    return merged.samples();
+}
+
+// randstream_parallel returns random sample of k elements from the union of
+// unbounded streams, which are sampled in parallel.
+template <typename T>
+std::vector<T>
+randstream_parallel(const std::vector<std::istream*>& shards, std::size_t k,
+                    std::uint64_t seed=std::random_device{}())
+{
+    std::vector<IstreamSource<T>> sources;
+    sources.reserve(shards.size());
+    for (auto* is : shards) {
+        sources.emplace_back(*is);
+    }
+    return parallel_reservoir_sample<T>(sources, k, seed);
+}
+
+// bit_width returns the number of bits needed to represent n.
+constexpr std::size_t
+bit_width(std::uint64_t n)
+{
+    std::size_t width = 0;
+    for (; n > 0; n >>= 1) {
+        ++width;
+    }
+    return width;
+}
+
+// WindowSampler is a uniform random sample of k elements, drawn with
+// replacement, from a sliding window over a stream, i.e. the elements at
+// positions (t-width, t] where t is the position of the latest element.
+// Positions are nondecreasing and may count elements, for a window over the
+// last width elements, or be timestamps, for a window over the last width
+// units of time.
+//
+// Each of the k samples is kept by its own chain (Babcock et al., 2002).
+// Every element is given a random priority and the sample is the element of
+// highest priority in the window.  A chain keeps only the elements which
+// have a higher priority than every later element, since any other element
+// can never again be the highest in the window.  The chain is a deque with
+// priorities decreasing from front to back, which holds about ln(width)
+// elements.  New elements are appended at the back after popping the
+// elements they outrank, and the front is popped once it leaves the window.
+//
+// Rather than drawing k priorities for every element, add buffers elements
+// in a batch, which costs O(1).  When the batch is full, or a sample is
+// requested, each chain draws only the priorities of the elements of the
+// batch which outrank every later element of the batch.  Going from the
+// newest element back, the next such element is the first whose priority
+// exceeds p, the priority of the last one found, so the number of elements
+// skipped is geometrically distributed with probability of success 1-p and
+// its priority is uniform over (p, 1).  A batch of b elements yields about
+// ln(b) of them per chain.  A batch is merged once it holds k(lg(k)+5)
+// elements more than twice the c elements of the chains, so adding an
+// element costs amortized O(1) and at most 3c + k(lg(k)+5) elements, which
+// is O(k log(width)), are held.
+//
+// Since the chains are independent, the same element may be sampled more
+// than once.  WindowSamplerWithoutReplacement returns distinct elements.
+template <typename T>
+class WindowSampler
+{
+  public:
+    WindowSampler(std::size_t k, std::uint64_t width)
+        : width_(width)
+        , batch_size_(k*(bit_width(k)+4) + 1)
+        , chains_(k)
+    { }
+
+    // add adds x at position t to the window.
+    template <typename Engine>
+    void add(const T& x, std::uint64_t t, Engine& gen)
+    {
+        expire(t);
+        batch_.emplace_back(Entry{0.0, t, x});
+        if (batch_.size() >= batch_size_ + 2*nchained_) {
+            merge(gen);
+        }
+    }
+
+    // expire removes the buffered elements which are outside of the window
+    // ending at position t.  The chains are expired when they are merged.
+    void expire(std::uint64_t t)
+    {
+        t_ = t;
+        while (!batch_.empty() && expired(batch_.front())) {
+            batch_.pop_front();
+        }
+    }
+
+    // sample returns k elements drawn with replacement from the window, or
+    // no elements when the window is empty.
+    template <typename Engine>
+    std::vector<T> sample(Engine& gen)
+    {
+        merge(gen);
+        std::vector<T> samples;
+        samples.reserve(chains_.size());
+        for (const auto& chain : chains_) {
+            if (!chain.empty()) {
+                samples.emplace_back(chain.front().x);
+            }
+        }
+        return samples;
+    }
+
+    // size returns the number of elements kept by all of the chains and
+    // buffered in the batch.
+    std::size_t size() const
+    {
+        return nchained_ + batch_.size();
+    }
+
+  private:
+    struct Entry
+    {
+        double priority;
+        std::uint64_t t;
+        T x;
+    };
+
+    bool expired(const Entry& entry) const
+    {
+        return t_ - entry.t >= width_;
+    }
+
+    // merge expires the front of each chain and appends the elements of
+    // the batch which outrank every later element in the batch.
+    template <typename Engine>
+    void merge(Engine& gen)
+    {
+        // uniform returns a random number from the open interval (0, 1).
+        std::uniform_real_distribution<double> udis(0.0, 1.0);
+        auto uniform = [&udis, &gen]() {
+            double u;
+            do {
+                u = udis(gen);
+            } while (u == 0.0);
+            return u;
+        };
+
+        nchained_ = 0;
+        for (auto& chain : chains_) {
+            while (!chain.empty() && expired(chain.front())) {
+                chain.pop_front();
+            }
+            if (batch_.empty()) {
+                nchained_ += chain.size();
+                continue;
+            }
+
+            // Find the suffix maxima of the batch from the newest back.
+            records_.clear();
+            std::size_t nleft = batch_.size()-1;
+            double p = uniform();
+            records_.emplace_back(nleft, p);
+            while (nleft > 0) {
+                double nskip = std::floor(std::log(uniform())/std::log(p));
+                if (nskip >= static_cast<double>(nleft)) {
+                    break;  // No earlier element outranks p.
+                }
+                nleft -= static_cast<std::size_t>(nskip)+1;
+                std::uniform_real_distribution<double> pdis(p, 1.0);
+                p = std::max(pdis(gen), p);
+                records_.emplace_back(nleft, p);
+            }
+
+            // Pop the dominated tail and append the records, oldest first.
+            while (!chain.empty() && chain.back().priority <= p) {
+                chain.pop_back();
+            }
+            for (auto it = records_.rbegin(); it != records_.rend(); ++it) {
+                const auto& entry = batch_[it->first];
+                chain.emplace_back(Entry{it->second, entry.t, entry.x});
+            }
+            nchained_ += chain.size();
+        }
+        batch_.clear();
+    }
+
+    std::uint64_t width_;
+    std::size_t batch_size_;
+    std::size_t nchained_{0};  // Elements in the chains after the last merge.
+    std::uint64_t t_{0};
+    std::vector<std::deque<Entry>> chains_;
+    std::deque<Entry> batch_;  // Elements not yet merged into the chains.
+    std::vector<std::pair<std::size_t, double>> records_;
+};
+
+// WindowSamplerWithoutReplacement is a uniform random sample of k distinct
+// elements from a sliding window over a stream, with positions as for
+// WindowSampler.
+//
+// Every element is given a single random priority and the sample is the k
+// elements of highest priority in the window.  An element which is
+// outranked by k later elements can never again be in the sample, since
+// they leave the window after it does, so only the other elements are
+// kept, about c = k(1 + ln(width/k)) of them.
+//
+// As for WindowSampler, add buffers elements in a batch.  A merge walks the
+// batch and then the kept elements from the newest back, holding the k
+// highest priorities seen in a min-heap, and keeps an element only when its
+// priority exceeds the smallest of them.  Within the batch, the number of
+// elements skipped before the next one kept is geometrically distributed
+// with probability of success 1-p, for p the smallest priority in the heap,
+// so only the priorities of the kept elements are drawn.  A merge costs
+// O((c + k ln(b/k)) lg k) for a batch of b elements, so batches of
+// (c + k) lg(k) elements make adding an element cost amortized O(1), with
+// O(k lg(k) ln(width/k)) elements held.  The heap left after the merge is the
+// sample, so sample merges only when elements have been added or have left
+// the window since the last merge.
+template <typename T>
+class WindowSamplerWithoutReplacement
+{
+  public:
+    WindowSamplerWithoutReplacement(std::size_t k, std::uint64_t width)
+        : k_(k)
+        , width_(width)
+    { }
+
+    // add adds x at position t to the window.
+    template <typename Engine>
+    void add(const T& x, std::uint64_t t, Engine& gen)
+    {
+        if (k_ == 0) {
+            return;
+        }
+        expire(t);
+        batch_.emplace_back(Entry{0.0, t, x});
+        if (batch_.size() >= (kept_.size() + k_)*bit_width(k_)) {
+            merge(gen);
+        }
+    }
+
+    // expire removes the buffered elements which are outside of the window
+    // ending at position t.  The kept elements are expired when merged.
+    void expire(std::uint64_t t)
+    {
+        t_ = t;
+        while (!batch_.empty() && expired(batch_.front())) {
+            batch_.pop_front();
+        }
+    }
+
+    // sample returns min(k, n) distinct elements of the n in the window.
+    template <typename Engine>
+    std::vector<T> sample(Engine& gen)
+    {
+        if (!batch_.empty() || (!kept_.empty() && expired(kept_.front()))) {
+            merge(gen);
+        }
+        std::vector<T> samples;
+        samples.reserve(heap_.size());
+        for (const auto& top : heap_) {
+            samples.emplace_back(kept_[top.second].x);
+        }
+        return samples;
+    }
+
+    // size returns the number of elements kept and buffered in the batch.
+    std::size_t size() const
+    {
+        return kept_.size() + batch_.size();
+    }
 
+  private:
+    struct Entry
+    {
+        double priority;
+        std::uint64_t t;
+        T x;
+    };
+
+    // Top is the priority of a kept element and its index in kept_.
+    using Top = std::pair<double, std::size_t>;
+
+    bool expired(const Entry& entry) const
+    {
+        return t_ - entry.t >= width_;
+    }
+
+    // merge replaces the kept elements with those of the window, including
+    // the batch, which are outranked by fewer than k later elements, and
+    // leaves the k of highest priority in heap_.
+    template <typename Engine>
+    void merge(Engine& gen)
+    {
+        // uniform returns a random number from the open interval (0, 1).
+        std::uniform_real_distribution<double> udis(0.0, 1.0);
+        auto uniform = [&udis, &gen]() {
+            double u;
+            do {
+                u = udis(gen);
+            } while (u == 0.0);
+            return u;
+        };
+        auto greater = [](const Top& a, const Top& b) {
+            return a.first > b.first;
+        };
+
+        // keep appends entry to merged, newest first, when it is outranked
+        // by fewer than k of the elements already merged.
+        std::vector<Entry> merged;
+        heap_.clear();
+        auto keep = [&](const Entry& entry) {
+            if (heap_.size() == k_) {
+                if (entry.priority <= heap_.front().first) {
+                    return;
+                }
+                std::pop_heap(std::begin(heap_), std::end(heap_), greater);
+                heap_.pop_back();
+            }
+            heap_.emplace_back(entry.priority, merged.size());
+            std::push_heap(std::begin(heap_), std::end(heap_), greater);
+            merged.emplace_back(entry);
+        };
+
+        // Draw priorities only for the elements of the batch which are
+        // kept, skipping those which the heap would reject.
+        std::size_t nleft = batch_.size();
+        while (nleft > 0) {
+            auto entry = batch_[nleft-1];
+            if (heap_.size() < k_) {
+                entry.priority = uniform();
+                --nleft;
+            }
+            else {
+                double p = heap_.front().first;
+                double nskip = std::floor(std::log(uniform())/std::log(p));
+                if (nskip >= static_cast<double>(nleft)) {
+                    break;  // No earlier element outranks p.
+                }
+                nleft -= static_cast<std::size_t>(nskip)+1;
+                entry = batch_[nleft];
+                std::uniform_real_distribution<double> pdis(p, 1.0);
+                entry.priority = std::nextafter(std::max(pdis(gen), p), 1.0);
+            }
+            keep(entry);
+        }
+        batch_.clear();
+
+        // The kept elements which have not left the window are next.
+        for (auto it = kept_.rbegin();
+                it != kept_.rend() && !expired(*it); ++it) {
+            keep(*it);
+        }
+
+        // Restore position order and point the heap at the new indices.
+        std::reverse(std::begin(merged), std::end(merged));
+        for (auto& top : heap_) {
+            top.second = merged.size()-1 - top.second;
+        }
+        kept_ = std::move(merged);
+    }
+
+    std::size_t k_;
+    std::uint64_t width_;
+    std::uint64_t t_{0};
+    std::vector<Entry> kept_;  // Kept elements in order of position.
+    std::deque<Entry> batch_;  // Elements not yet merged.
+    std::vector<Top> heap_;    // Min-heap of the k highest priorities.
+};
+
+// chisq_trials returns the chisq statistic of the histogram of samples
+// returned by sampler(is, k) from nrepeat shuffled streams of [1, n].
+template <typename T, typename Sampler>
+double
+chisq_trials(Sampler&& sampler, std::size_t k, std::size_t n,
+             std::size_t nrepeat)
+{
     // Compute the expected count in each bin.
     double expected = static_cast<double>(nrepeat)*
         static_cast<double>(k)/static_cast<double>(n);
@@ -79,7 +992,7 @@ TEST_CASE("chisq", "[randstream]")
                   std::ostream_iterator<T>(ss, " "));
 
         // Obtain k random samples from stream of size n, with k < n.
-        auto rsamples = randstream<T>(ss, k);
+        auto rsamples = sampler(ss, k);
         REQUIRE(rsamples.size() == k);
 
         // Increment the count for each sample.
@@ -101,12 +1014,600 @@ TEST_CASE("chisq", "[randstream]")
             return ssq + (xi-expected)*(xi-expected)/expected;
         }
     );
+    CAPTURE(expected);
+    return chisq;
+}
 
-    // Compare the chisq statistic to pvalue.
-    int df = n-1;
-    constexpr double pvalue = 148.21; // P=0.001
-    CAPTURE(k, n, expected, df, chisq, pvalue);
-    // Null hypothesis H0 is that numbers are from uniform distribution.
-    // When chisqx <= pvalue, then we fail to reject the null hypothesis.
+// require_chisq requires that a chisq statistic with df degrees of freedom
+// does not reject the null hypothesis H0 that the samples follow the
+// expected distribution at P=0.001.
+void
+require_chisq(double chisq, int df)
+{
+    // Critical values of the chisq distribution at P=0.001.
+    static const std::map<int, double> pvalues{{19, 43.82}, {99, 148.21}};
+    auto pvalue = pvalues.at(df);
+    CAPTURE(df, chisq, pvalue);
+    // When chisq <= pvalue, then we fail to reject the null hypothesis.
     REQUIRE(chisq <= pvalue);
 }
+
+// CountingEngine counts the number of random numbers drawn.
+struct CountingEngine : std::mt19937
+{
+    using std::mt19937::mt19937;
+    result_type operator()()
+    {
+        ++ndraws;
+        return std::mt19937::operator()();
+    }
+    std::size_t ndraws{0};
+};
+
+TEST_CASE("chisq", "[randstream]")
+{
+    using T = std::uint32_t;
+
+    // Simulation parameters.
+    std::size_t k = 10; // Number of samples to return from each trial.
+    std::size_t n = 100; // Size of the stream.
+    std::size_t nrepeat = 10000; // Number of trials.
+
+    double chisq = chisq_trials<T>(
+        [](std::istream& is, std::size_t k) { return randstream<T>(is, k); },
+        k, n, nrepeat);
+
+    CAPTURE(k, n);
+    require_chisq(chisq, n-1);
+}
+
+TEST_CASE("chisq algorithm l", "[randstream]")
+{
+    using T = std::uint32_t;
+
+    // Simulation parameters.
+    std::size_t k = 10; // Number of samples to return from each trial.
+    std::size_t n = 100; // Size of the stream.
+    std::size_t nrepeat = 10000; // Number of trials.
+
+    double chisq = chisq_trials<T>(
+        [](std::istream& is, std::size_t k) { return randstream_l<T>(is, k); },
+        k, n, nrepeat);
+
+    CAPTURE(k, n);
+    require_chisq(chisq, n-1);
+}
+
+TEST_CASE("chisq weighted", "[randstream]")
+{
+    using T = std::uint32_t;
+
+    // Simulation parameters.
+    std::size_t k = 10; // Number of samples to return from each trial.
+    std::size_t n = 100; // Size of the stream.
+    std::size_t nrepeat = 10000; // Number of trials.
+
+    // With equal weights, the sample is uniform.
+    double chisq = chisq_trials<T>(
+        [](std::istream& is, std::size_t k) {
+            return randstream_weighted<T>(is, k, [](T) { return 2.5; });
+        },
+        k, n, nrepeat);
+
+    CAPTURE(k, n);
+    require_chisq(chisq, n-1);
+}
+
+TEST_CASE("chisq weighted proportional", "[randstream]")
+{
+    using T = std::uint32_t;
+
+    // Simulation parameters.
+    std::size_t n = 20; // Size of the stream.
+    std::size_t nrepeat = 20000; // Number of trials.
+    std::mt19937 gen{std::random_device{}()};
+
+    // Initialize monotonic sequence from [1, n].
+    std::vector<T> sequence(n);
+    std::iota(std::begin(sequence), std::end(sequence), T{1});
+
+    // A single sample selects element x with probability x/sum([1, n]).
+    auto weight = [](T x) { return static_cast<double>(x); };
+    std::vector<std::uint32_t> hist(n, 0);
+    for (std::size_t ii = 0; ii < nrepeat; ++ii) {
+        std::shuffle(std::begin(sequence), std::end(sequence), gen);
+        std::stringstream ss;
+        std::copy(std::begin(sequence), std::end(sequence),
+                  std::ostream_iterator<T>(ss, " "));
+        auto rsamples = randstream_weighted<T>(ss, 1, weight, gen);
+        REQUIRE(rsamples.size() == 1);
+        hist[rsamples[0]-1] += 1;
+    }
+
+    // Compute the sum of squares of observed minus expected over expected.
+    double total = n*(n+1)/2.0;
+    double chisq = 0.0;
+    for (std::size_t ii = 0; ii < n; ++ii) {
+        double expected = nrepeat*(ii+1)/total;
+        CAPTURE(ii, hist[ii], expected);
+        chisq += (hist[ii]-expected)*(hist[ii]-expected)/expected;
+    }
+
+    CAPTURE(n);
+    require_chisq(chisq, n-1);
+}
+
+TEST_CASE("weighted", "[randstream]")
+{
+    using T = std::uint32_t;
+
+    std::mt19937 gen(42);
+    std::vector<T> rsamples;
+
+    // Elements of weight <= 0 are never selected.
+    for (std::size_t k : {0, 1, 5, 10}) {
+        std::stringstream ss("1 2 3 4 5 6 7 8 9 10");
+        rsamples = randstream_weighted<T>(
+            ss, k, [](T x) { return x % 2 == 0 ? 0.0 : 1.0; }, gen);
+        CAPTURE(k);
+        REQUIRE(rsamples.size() == std::min<std::size_t>(k, 5));
+        for (const auto x : rsamples) {
+            REQUIRE(x % 2 == 1);
+        }
+    }
+
+    std::size_t k = 10, n = 100000;
+    std::stringstream ss;
+    for (std::size_t i = 1; i <= n; ++i) {
+        ss << i << ' ';
+    }
+    CountingEngine counting_gen{42};
+    rsamples = randstream_weighted<T>(
+        ss, k, [](T x) { return static_cast<double>(x); }, counting_gen);
+    REQUIRE(rsamples.size() == k);
+
+    // Random numbers are drawn only to fill the reservoir and to accept an
+    // element, which for weights equal to the position in the stream
+    // happens about 2k ln(n/k) times, rather than once for each element.
+    CAPTURE(counting_gen.ndraws);
+    REQUIRE(counting_gen.ndraws < 2000);
+}
+
+TEST_CASE("chisq parallel", "[randstream]")
+{
+    using T = std::uint32_t;
+
+    // Simulation parameters.
+    std::size_t k = 10; // Number of samples to return from each trial.
+    std::size_t n = 100; // Size of the stream.
+    std::size_t nrepeat = 10000; // Number of trials.
+
+    // Split the stream into uneven shards, including shards smaller than
+    // the reservoir and an empty shard.
+    auto sampler = [](std::istream& is, std::size_t k) {
+        static std::uint64_t seed = std::random_device{}();
+        std::array<std::stringstream, 5> shards;
+        std::array<std::size_t, 5> sizes = {3, 0, 50, 7, 40};
+        T x;
+        for (std::size_t ii = 0; ii < shards.size(); ++ii) {
+            for (std::size_t jj = 0; jj < sizes[ii] && is >> x; ++jj) {
+                shards[ii] << x << ' ';
+            }
+        }
+        std::vector<std::istream*> streams;
+        for (auto& shard : shards) {
+            streams.emplace_back(&shard);
+        }
+        return randstream_parallel<T>(streams, k, seed++);
+    };
+    double chisq = chisq_trials<T>(sampler, k, n, nrepeat);
+
+    CAPTURE(k, n);
+    require_chisq(chisq, n-1);
+}
+
+TEST_CASE("reservoir merge", "[randstream]")
+{
+    using T = std::uint32_t;
+
+    std::mt19937 gen(42);
+
+    // Merging reservoirs which have seen fewer than k elements keeps every
+    // element.
+    Reservoir<T> a(10), b(10);
+    for (T x : {1, 2, 3}) {
+        a.add(x, gen);
+    }
+    for (T x : {4, 5}) {
+        b.add(x, gen);
+    }
+    a.merge(b, gen);
+    REQUIRE(a.count() == 5);
+    auto samples = a.samples();
+    std::sort(std::begin(samples), std::end(samples));
+    REQUIRE(samples == std::vector<T>{1, 2, 3, 4, 5});
+
+    // Merging with an empty reservoir leaves the sample unchanged.
+    Reservoir<T> c(10), empty(10);
+    for (T x = 1; x <= 100; ++x) {
+        c.add(x, gen);
+    }
+    auto before = c.samples();
+    c.merge(empty, gen);
+    REQUIRE(c.count() == 100);
+    REQUIRE(c.samples().size() == 10);
+    samples = c.samples();
+    std::sort(std::begin(samples), std::end(samples));
+    std::sort(std::begin(before), std::end(before));
+    REQUIRE(samples == before);
+
+    // The merged sample holds k elements of the union.
+    c.merge(a, gen);
+    REQUIRE(c.count() == 105);
+    REQUIRE(c.samples().size() == 10);
+    REQUIRE(std::all_of(std::begin(c.samples()), std::end(c.samples()),
+                        [](T x) { return x >= 1 && x <= 100; }));
+
+    // Reservoirs of different sizes cannot be merged.
+    Reservoir<T> d(5);
+    REQUIRE_THROWS_AS(c.merge(d, gen), std::invalid_argument);
+
+    // The same seed gives the same sample regardless of thread timing.
+    std::string text("1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16");
+    std::stringstream s1(text), s2(text), s3(text), s4(text);
+    std::vector<std::istream*> shards1{&s1, &s2}, shards2{&s3, &s4};
+    REQUIRE(randstream_parallel<T>(shards1, 4, 42) ==
+            randstream_parallel<T>(shards2, 4, 42));
+}
+
+TEST_CASE("chisq window", "[randstream]")
+{
+    using T = std::uint32_t;
+
+    // Simulation parameters.
+    std::size_t k = 10; // Number of samples to return from each trial.
+    std::size_t n = 150; // Size of the stream.
+    std::size_t w = 100; // Size of the window.
+    std::size_t nrepeat = 10000; // Number of trials.
+    std::mt19937 gen{std::random_device{}()};
+
+    // chisq_window returns the chisq statistic of the samples of the last
+    // w elements of the stream [1, n].
+    auto chisq_window = [&](auto make_sampler) {
+        std::vector<std::uint32_t> hist(w, 0);
+        for (std::size_t ii = 0; ii < nrepeat; ++ii) {
+            auto sampler = make_sampler();
+            for (T x = 1; x <= n; ++x) {
+                sampler.add(x, x, gen);
+            }
+            auto rsamples = sampler.sample(gen);
+            REQUIRE(rsamples.size() == k);
+            for (const auto& x : rsamples) {
+                REQUIRE(x > n-w);
+                hist[x-(n-w)-1] += 1;
+            }
+        }
+
+        // Compute the sum of squares of observed minus expected over
+        // expected.
+        double expected = static_cast<double>(nrepeat*k)/w;
+        double chisq = 0.0;
+        for (std::size_t ii = 0; ii < w; ++ii) {
+            CAPTURE(ii, hist[ii]);
+            chisq += (hist[ii]-expected)*(hist[ii]-expected)/expected;
+        }
+        return chisq;
+    };
+
+    CAPTURE(k, n, w);
+    require_chisq(chisq_window([=]() { return WindowSampler<T>(k, w); }),
+                  w-1);
+    require_chisq(chisq_window([=]() {
+                      return WindowSamplerWithoutReplacement<T>(k, w);
+                  }),
+                  w-1);
+}
+
+TEST_CASE("window", "[randstream]")
+{
+    using T = std::uint32_t;
+
+    std::mt19937 gen(42);
+
+    // The window is empty until the first element is added.
+    std::size_t k = 4;
+    WindowSampler<T> sampler(k, 1000);
+    REQUIRE(sampler.sample(gen).empty());
+
+    // Each chain keeps about ln(width) elements, and a batch is merged once
+    // it holds k(lg(k)+5) more than twice the elements of the chains.
+    std::size_t maxsize = 0, maxchains = 0;
+    for (T x = 0; x < 100000; ++x) {
+        sampler.add(x, x, gen);
+        maxsize = std::max(maxsize, sampler.size());
+        if (x % 97 == 0) {
+            REQUIRE(sampler.sample(gen).size() == k);
+            maxchains = std::max(maxchains, sampler.size());
+        }
+    }
+    CAPTURE(maxsize, maxchains);
+    REQUIRE(maxchains <= 4*k*std::log(1000));
+    REQUIRE(maxsize <= 3*4*k*std::log(1000) + k*(bit_width(k)+4) + 1);
+
+    // With timestamps, the window holds the elements of the last width
+    // units of time, however many elements arrive in each unit.
+    WindowSampler<T> timed(8, 10);
+    for (T x = 0; x < 1000; ++x) {
+        timed.add(x, x/100, gen);  // 100 elements per unit of time.
+    }
+    REQUIRE(timed.sample(gen).size() == 8);  // Every element is in (-1, 9].
+    timed.expire(15);
+    REQUIRE(timed.sample(gen).size() == 8);
+    for (const auto x : timed.sample(gen)) {
+        REQUIRE(x >= 600);
+    }
+    timed.expire(19);
+    REQUIRE(timed.sample(gen).empty());
+    REQUIRE(timed.size() == 0);
+}
+
+TEST_CASE("window without replacement", "[randstream]")
+{
+    using T = std::uint32_t;
+
+    std::mt19937 gen(42);
+
+    // The sample holds every element until the window holds k elements.
+    std::size_t k = 8;
+    std::uint64_t w = 1000;
+    WindowSamplerWithoutReplacement<T> sampler(k, w);
+    REQUIRE(sampler.sample(gen).empty());
+    for (T x = 0; x < 5; ++x) {
+        sampler.add(x, x, gen);
+    }
+    auto rsamples = sampler.sample(gen);
+    std::sort(std::begin(rsamples), std::end(rsamples));
+    REQUIRE(rsamples == std::vector<T>{0, 1, 2, 3, 4});
+
+    // Samples are distinct elements of the window, about c = k(1 + ln(w/k))
+    // elements are kept, and at most (c + k) lg(k) are buffered.
+    std::size_t maxsize = 0, maxkept = 0;
+    for (T x = 5; x < 20000; ++x) {
+        sampler.add(x, x, gen);
+        maxsize = std::max(maxsize, sampler.size());
+        if (x % 97 == 0) {
+            sampler.sample(gen);
+            maxkept = std::max(maxkept, sampler.size());
+        }
+        if (x % 1000 == 0) {
+            rsamples = sampler.sample(gen);
+            std::sort(std::begin(rsamples), std::end(rsamples));
+            CAPTURE(x, rsamples);
+            REQUIRE(rsamples.size() == k);
+            REQUIRE(std::adjacent_find(std::begin(rsamples),
+                                       std::end(rsamples))
+                    == std::end(rsamples));
+            REQUIRE(rsamples.front() > x-w);
+        }
+    }
+    double c = 2*k*(1 + std::log(w/k));
+    CAPTURE(maxsize, maxkept, c);
+    REQUIRE(maxkept <= c);
+    REQUIRE(maxsize <= c + (c + k)*bit_width(k));
+
+    // With timestamps, expiring the whole window empties the sample.
+    sampler.expire(20000+w);
+    REQUIRE(sampler.sample(gen).empty());
+    REQUIRE(sampler.size() == 0);
+}
+
+TEST_CASE("xoshiro256pp", "[randstream]")
+{
+    using T = std::uint32_t;
+
+    // Sampling is reproducible from a seed and stream id, so trials can be
+    // split across threads and rerun with identical results.
+    std::vector<T> sequence(1000);
+    std::iota(std::begin(sequence), std::end(sequence), T{1});
+    std::stringstream ss;
+    std::copy(std::begin(sequence), std::end(sequence),
+              std::ostream_iterator<T>(ss, " "));
+    auto sample = [&ss](std::uint64_t seed, std::size_t id) {
+        std::stringstream is(ss.str());
+        auto gen = Xoshiro256pp::stream(seed, id);
+        return randstream<T>(is, 10, gen);
+    };
+    REQUIRE(sample(42, 0) == sample(42, 0));
+    REQUIRE(sample(42, 7) == sample(42, 7));
+    REQUIRE(sample(42, 0) != sample(42, 1));
+
+    // Thread local generators are selected by the template parameter.
+    std::stringstream is(ss.str());
+    REQUIRE(randstream<T, Xoshiro256pp>(is, 10).size() == 10);
+}
+
+TEST_CASE("algorithm l draws", "[randstream]")
+{
+    using T = std::uint32_t;
+
+    std::size_t k = 10, n = 100000;
+    std::stringstream ss;
+    for (std::size_t i = 1; i <= n; ++i) {
+        ss << i << ' ';
+    }
+    CountingEngine gen{42};
+    auto rsamples = randstream_l<T>(ss, k, gen);
+    REQUIRE(rsamples.size() == k);
+    REQUIRE(std::all_of(std::begin(rsamples), std::end(rsamples),
+                        [n](T x) { return x >= 1 && x <= n; }));
+
+    // Expect about k(1 + ln(n/k)) replacements of a few draws each, rather
+    // than one draw for each of the n elements.
+    CAPTURE(gen.ndraws);
+    REQUIRE(gen.ndraws < 2000);
+
+    // Streams shorter than the reservoir are returned whole.
+    std::stringstream short_ss("1 2 3");
+    REQUIRE(randstream_l<T>(short_ss, k, gen) == std::vector<T>{1, 2, 3});
+}
+
+TEST_CASE("sources", "[randstream]")
+{
+    using T = std::uint32_t;
+
+    // Write the same stream of [1, n] as formatted, binary, and delimited.
+    std::size_t n = 1000;
+    std::vector<T> sequence(n);
+    std::iota(std::begin(sequence), std::end(sequence), T{1});
+    std::stringstream formatted;
+    std::copy(std::begin(sequence), std::end(sequence),
+              std::ostream_iterator<T>(formatted, " "));
+    std::string binary(reinterpret_cast<const char*>(sequence.data()),
+                       n*sizeof(T));
+    std::string delimited;
+    for (const auto x : sequence) {
+        delimited += std::to_string(x) + (x % 3 == 0 ? "\r\n\n" : "\n");
+    }
+
+    // Every source yields the same elements and skips the same elements.
+    auto read_all = [](auto& source) {
+        std::vector<T> xs;
+        T x;
+        while (source.next(x)) {
+            xs.emplace_back(x);
+            source.skip(x % 4);
+        }
+        return xs;
+    };
+    std::vector<T> expected;
+    for (T x = 1; x <= n; x += x % 4 + 1) {
+        expected.emplace_back(x);
+    }
+    IstreamSource<T> istream_source(formatted);
+    BinarySource<T> binary_source(binary.data(), binary.size());
+    DelimitedSource<T> delimited_source(delimited.data(), delimited.size());
+    REQUIRE(read_all(istream_source) == expected);
+    REQUIRE(read_all(binary_source) == expected);
+    REQUIRE(read_all(delimited_source) == expected);
+
+    // Since sampling is decoupled from the source, identically seeded
+    // generators select identical samples from every source.
+    for (std::size_t k : {1, 10, 100}) {
+        std::stringstream is(formatted.str());
+        BinarySource<T> binary_source(binary.data(), binary.size());
+        DelimitedSource<T> delimited_source(delimited.data(),
+                                            delimited.size());
+        std::mt19937 gen1(k), gen2(k), gen3(k);
+        auto rcv = randstream_l<T>(is, k, gen1);
+        CAPTURE(k);
+        REQUIRE(rcv.size() == k);
+        REQUIRE(reservoir_sample_l<T>(binary_source, k, gen2) == rcv);
+        REQUIRE(reservoir_sample_l<T>(delimited_source, k, gen3) == rcv);
+    }
+
+    // Delimited text ends at the first line without an integer, whether it
+    // is reached by next or by skip, and blank lines ending in "\r\n" are
+    // ignored.
+    std::string malformed("1\r\n\r\n2\nthree\n4\n");
+    DelimitedSource<T> malformed_source(malformed.data(), malformed.size());
+    std::vector<T> xs;
+    T x;
+    while (malformed_source.next(x)) {
+        xs.emplace_back(x);
+    }
+    REQUIRE(xs == std::vector<T>{1, 2});
+    DelimitedSource<T> skipped_source(malformed.data(), malformed.size());
+    REQUIRE(skipped_source.skip(4) == 2);
+    REQUIRE(!skipped_source.next(x));
+
+    // Both samplers see the same population from a malformed buffer, so
+    // Algorithm L never skips past the malformed line to later elements.
+    std::string truncated("1\n2\n3\n4\n5\nsix\n");
+    for (T x = 7; x <= n; ++x) {
+        truncated += std::to_string(x) + "\n";
+    }
+    for (std::size_t k : {1, 2, 3}) {
+        for (std::uint32_t seed = 0; seed < 20; ++seed) {
+            DelimitedSource<T> source(truncated.data(), truncated.size());
+            DelimitedSource<T> source_l(truncated.data(), truncated.size());
+            std::mt19937 gen(seed);
+            auto rcv = reservoir_sample<T>(source, k, gen);
+            auto rcv_l = reservoir_sample_l<T>(source_l, k, gen);
+            CAPTURE(k, seed, rcv, rcv_l);
+            REQUIRE(rcv.size() == k);
+            REQUIRE(rcv_l.size() == k);
+            REQUIRE(*std::max_element(std::begin(rcv), std::end(rcv)) <= 5);
+            REQUIRE(*std::max_element(std::begin(rcv_l), std::end(rcv_l))
+                    <= 5);
+        }
+    }
+}
+
+TEST_CASE("sources benchmark", "[.benchmark][randstream]")
+{
+    using T = std::uint32_t;
+
+    std::size_t n = 1000000, k = 100;
+    std::mt19937 gen(42);
+    std::vector<T> sequence(n);
+    std::iota(std::begin(sequence), std::end(sequence), T{1});
+    std::string binary(reinterpret_cast<const char*>(sequence.data()),
+                       n*sizeof(T));
+    std::string delimited;
+    for (const auto x : sequence) {
+        delimited += std::to_string(x) + "\n";
+    }
+
+    BENCHMARK("IstreamSource")
+    {
+        std::istringstream is(delimited);
+        IstreamSource<T> source(is);
+        return reservoir_sample<T>(source, k, gen);
+    };
+
+    BENCHMARK("DelimitedSource")
+    {
+        DelimitedSource<T> source(delimited.data(), delimited.size());
+        return reservoir_sample<T>(source, k, gen);
+    };
+
+    BENCHMARK("BinarySource")
+    {
+        BinarySource<T> source(binary.data(), binary.size());
+        return reservoir_sample<T>(source, k, gen);
+    };
+
+    BENCHMARK("DelimitedSource with Algorithm L")
+    {
+        DelimitedSource<T> source(delimited.data(), delimited.size());
+        return reservoir_sample_l<T>(source, k, gen);
+    };
+}
+
+TEST_CASE("window benchmark", "[.benchmark][randstream]")
+{
+    using T = std::uint32_t;
+
+    // Each run adds 100M elements, so pass e.g. --benchmark-samples 5.
+    std::size_t n = 100000000, k = 10;
+    std::uint64_t w = 1000000;
+    Xoshiro256pp gen(42);
+
+    BENCHMARK("WindowSampler")
+    {
+        WindowSampler<T> sampler(k, w);
+        for (std::size_t x = 0; x < n; ++x) {
+            sampler.add(static_cast<T>(x), x, gen);
+        }
+        return sampler.sample(gen);
+    };
+
+    BENCHMARK("WindowSamplerWithoutReplacement")
+    {
+        WindowSamplerWithoutReplacement<T> sampler(k, w);
+        for (std::size_t x = 0; x < n; ++x) {
+            sampler.add(static_cast<T>(x), x, gen);
+        }
+        return sampler.sample(gen);
+    };
+}
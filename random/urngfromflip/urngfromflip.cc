@@ -1,50 +1,472 @@
-#include <cmath>
+#include <algorithm>
+#include <array>
 #include <cstddef>
 #include <cstdint>
+#include <functional>
 #include <iterator>
+#include <numeric>
 #include <random>
+#include <thread>
 #include <type_traits>
+#include <utility>
 #include <vector>
 
-// Let Catch provide main().
+// Let Catch provide main() and benchmarks.
 #define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
 #include "catch2/catch.hpp"
 
-// flip returns 0 or 1 with equal probability.
+// bit_width returns the number of bits needed to represent n.
+constexpr std::size_t
+bit_width(std::uint64_t n)
+{
+    std::size_t width = 0;
+    for (; n != 0; n >>= 1) {
+        ++width;
+    }
+    return width;
+}
+
+// splitmix64 returns the next output of the SplitMix64 generator, which is
+// used to expand a single seed into the state of a larger generator.
+constexpr std::uint64_t
+splitmix64(std::uint64_t& x)
+{
+    std::uint64_t z = (x += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+}
+
+// rotl rotates x left by k bits.
+constexpr std::uint64_t
+rotl(std::uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+// Xoshiro256pp is the xoshiro256++ generator of (Blackman and Vigna, 2021).
+//
+// jump advances the generator by 2^128 outputs and long_jump by 2^192, so a
+// single seed yields reproducible streams which do not overlap in practice.
+class Xoshiro256pp
+{
+  public:
+    using result_type = std::uint64_t;
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return ~result_type{0}; }
+
+    explicit Xoshiro256pp(std::uint64_t seed=0)
+    {
+        for (auto& x : s_) {
+            x = splitmix64(seed);
+        }
+    }
+
+    // stream returns the generator for stream id of the given seed.
+    static Xoshiro256pp stream(std::uint64_t seed, std::size_t id)
+    {
+        Xoshiro256pp gen(seed);
+        for (std::size_t i = 0; i < id; ++i) {
+            gen.long_jump();
+        }
+        return gen;
+    }
+
+    result_type operator()()
+    {
+        auto result = rotl(s_[0] + s_[3], 23) + s_[0];
+        auto t = s_[1] << 17;
+        s_[2] ^= s_[0];
+        s_[3] ^= s_[1];
+        s_[1] ^= s_[2];
+        s_[0] ^= s_[3];
+        s_[2] ^= t;
+        s_[3] = rotl(s_[3], 45);
+        return result;
+    }
+
+    void jump()
+    {
+        static constexpr std::uint64_t poly[] = {
+            0x180ec6d33cfd0aba, 0xd5a61266f0c9392c,
+            0xa9582618e03fc9aa, 0x39abdc4529b1661c
+        };
+        advance(poly);
+    }
+
+    void long_jump()
+    {
+        static constexpr std::uint64_t poly[] = {
+            0x76e15d3efefdcbbf, 0xc5004e441c522fb3,
+            0x77710069854ee241, 0x39109bb02acbe635
+        };
+        advance(poly);
+    }
+
+    // state returns the 256 bit state of the generator.
+    const std::array<std::uint64_t, 4>& state() const
+    {
+        return s_;
+    }
+
+  private:
+    // advance multiplies the state by the jump polynomial poly.
+    void advance(const std::uint64_t (&poly)[4])
+    {
+        std::array<std::uint64_t, 4> s{};
+        for (const auto p : poly) {
+            for (int b = 0; b < 64; ++b) {
+                if (p & (std::uint64_t{1} << b)) {
+                    for (std::size_t i = 0; i < s.size(); ++i) {
+                        s[i] ^= s_[i];
+                    }
+                }
+                (*this)();
+            }
+        }
+        s_ = s;
+    }
+
+    std::array<std::uint64_t, 4> s_;
+};
+
+// Xoshiro256ppx4 interleaves 4 xoshiro256++ generators, each one jump apart,
+// and steps them together so the compiler can keep one state word of every
+// lane in a single vector register.  Outputs are buffered and handed out in
+// lane order, so the sequence is reproducible from the seed alone.
+class Xoshiro256ppx4
+{
+  public:
+    using result_type = std::uint64_t;
+    static constexpr std::size_t lanes = 4;
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return ~result_type{0}; }
+
+    explicit Xoshiro256ppx4(std::uint64_t seed=0)
+        : Xoshiro256ppx4(Xoshiro256pp(seed))
+    { }
+
+    // Xoshiro256ppx4 starts lane i at gen advanced by i jumps.
+    explicit Xoshiro256ppx4(Xoshiro256pp gen)
+    {
+        for (std::size_t lane = 0; lane < lanes; ++lane) {
+            for (std::size_t i = 0; i < 4; ++i) {
+                s_[i][lane] = gen.state()[i];
+            }
+            gen.jump();
+        }
+    }
+
+    // stream returns the generator for stream id of the given seed.
+    static Xoshiro256ppx4 stream(std::uint64_t seed, std::size_t id)
+    {
+        return Xoshiro256ppx4(Xoshiro256pp::stream(seed, id));
+    }
+
+    result_type operator()()
+    {
+        if (next_ == buffer_.size()) {
+            fill(buffer_.data(), buffer_.size());
+            next_ = 0;
+        }
+        return buffer_[next_++];
+    }
+
+    // fill writes n outputs to out, where n is a multiple of lanes, with
+    // output i coming from lane i % lanes.
+    void fill(std::uint64_t* out, std::size_t n)
+    {
+        for (std::size_t k = 0; k+lanes <= n; k += lanes) {
+            for (std::size_t lane = 0; lane < lanes; ++lane) {
+                out[k+lane] = rotl(s_[0][lane] + s_[3][lane], 23)
+                    + s_[0][lane];
+            }
+            for (std::size_t lane = 0; lane < lanes; ++lane) {
+                auto t = s_[1][lane] << 17;
+                s_[2][lane] ^= s_[0][lane];
+                s_[3][lane] ^= s_[1][lane];
+                s_[1][lane] ^= s_[2][lane];
+                s_[0][lane] ^= s_[3][lane];
+                s_[2][lane] ^= t;
+                s_[3][lane] = rotl(s_[3][lane], 45);
+            }
+        }
+    }
+
+  private:
+    // s_[i][lane] is state word i of each lane.
+    std::array<std::array<std::uint64_t, lanes>, 4> s_;
+    std::array<std::uint64_t, 4*lanes> buffer_;
+    std::size_t next_{4*lanes};
+};
+
+// BitSource hands out random bits from a buffered word of engine output so
+// that a single call to the engine provides many bits.
+template <typename Engine=std::mt19937_64>
+class BitSource
+{
+  public:
+    // Every bit of the engine output must be random.
+    static_assert(Engine::min() == 0
+                  && (Engine::max() & (Engine::max()+1)) == 0,
+                  "engine must produce every pattern of its bits");
+
+    explicit BitSource(Engine engine=Engine{std::random_device{}()})
+        : engine_(engine)
+    { }
+
+    // flip returns 0 or 1 with equal probability.
+    std::uint8_t flip()
+    {
+        if (nbits_ == 0) {
+            refill();
+        }
+        std::uint8_t bit = word_ & 1;
+        word_ >>= 1;
+        --nbits_;
+        return bit;
+    }
+
+    // bits returns an integer whose n <= 64 least significant bits are
+    // random and whose other bits are 0.
+    std::uint64_t bits(std::size_t n)
+    {
+        std::uint64_t urng = 0;
+        for (std::size_t have = 0; have < n; ) {
+            if (nbits_ == 0) {
+                refill();
+            }
+            auto take = std::min(n-have, nbits_);
+            urng |= (word_ & mask(take)) << have;
+            word_ = take == 64 ? 0 : word_ >> take;
+            nbits_ -= take;
+            have += take;
+        }
+        return urng;
+    }
+
+  private:
+    static constexpr std::size_t engine_bits = bit_width(Engine::max());
+
+    // mask returns an integer whose n least significant bits are 1.
+    static std::uint64_t mask(std::size_t n)
+    {
+        return n == 64 ? ~std::uint64_t{0} : (std::uint64_t{1} << n) - 1;
+    }
+
+    void refill()
+    {
+        word_ = engine_();
+        nbits_ = engine_bits;
+    }
+
+    Engine engine_;
+    std::uint64_t word_{0};  // Bits not yet handed out.
+    std::size_t nbits_{0};   // Number of bits remaining in word_.
+};
+
+// thread_bit_source returns the thread local source used by flip,
+// urngfromflip, urngfromflip_n and urngfromflip_fdr, which is seeded from
+// std::random_device unless replaced by seed_flip.
+template <typename Engine=std::mt19937_64>
+BitSource<Engine>&
+thread_bit_source()
+{
+    thread_local BitSource<Engine> source;
+    return source;
+}
+
+// seed_flip replaces the thread local source of the calling thread with one
+// drawing from engine, so that its flips are reproducible.  For example,
+// seed_flip(Xoshiro256pp::stream(seed, id)) in each of several threads gives
+// every thread its own reproducible stream from a single seed.
+template <typename Engine>
+void
+seed_flip(const Engine& engine)
+{
+    thread_bit_source<Engine>() = BitSource<Engine>(engine);
+}
+
+// flip returns 0 or 1 with equal probability using a thread local Engine.
+template <typename Engine=std::mt19937_64>
 std::uint8_t
 flip()
 {
-    thread_local std::mt19937 gen{std::random_device{}()};
-    static constexpr double a = 0., b = 1., bias = 0.5;
-    std::uniform_int_distribution<> dis(a, b);
-    // NOTE(mmorais): Alter the value of bias to observe in change in chisq.
-    return dis(gen) < bias ? 0 : 1;
+    return thread_bit_source<Engine>().flip();
 }
 
-// urngfromflip returns a random integer in the range [a, b].
-template <typename IntegerT,
+// urngfromflip returns a random integer in the range [a, b] using the flips
+// of source.
+template <typename IntegerT, typename Engine,
           std::enable_if_t<std::is_integral<IntegerT>::value>* = nullptr>
 IntegerT
-urngfromflip(const IntegerT& a, const IntegerT& b)
+urngfromflip(const IntegerT& a, const IntegerT& b, BitSource<Engine>& source)
 {
     using T = std::uint64_t;
     // Compute the range.
     T n = b-a;
     // Compute the number of bits to represent the range.
-    T nbits = static_cast<T>(std::ceil(std::log(n)/std::log(2)));
+    T nbits = bit_width(n);
     // Use flip to obtain a value for each bit in nbits.
     std::uint64_t urng;
     do {
         urng = 0;
         // Concatenate each bit from least significant to most significant.
         for (T pos = 0; pos < nbits; ++pos) {
-            urng = urng | (flip()<<pos);
+            urng = urng | (static_cast<T>(source.flip())<<pos);
         }
     } while (urng > n);
     // Add the random integer back to the lower bound.
     return a + static_cast<IntegerT>(urng);
 }
 
+// urngfromflip returns a random integer in the range [a, b].
+template <typename IntegerT, typename Engine=std::mt19937_64,
+          std::enable_if_t<std::is_integral<IntegerT>::value>* = nullptr>
+IntegerT
+urngfromflip(const IntegerT& a, const IntegerT& b)
+{
+    return urngfromflip(a, b, thread_bit_source<Engine>());
+}
+
+// urngfromflip_n fills [first, last) with random integers in the range
+// [a, b] taking nbits at a time from source rather than one bit per flip.
+template <typename IntegerT, typename Iter, typename BitSourceT,
+          std::enable_if_t<std::is_integral<IntegerT>::value>* = nullptr>
+void
+urngfromflip_n(const IntegerT& a, const IntegerT& b,
+               Iter first, Iter last, BitSourceT& source)
+{
+    using T = std::uint64_t;
+    // Compute the range and number of bits once for every integer.
+    T n = b-a;
+    auto nbits = bit_width(n);
+    for (; first != last; ++first) {
+        T urng;
+        do {
+            urng = source.bits(nbits);
+        } while (urng > n);
+        *first = a + static_cast<IntegerT>(urng);
+    }
+}
+
+// urngfromflip_n fills [first, last) using a thread local source.
+template <typename IntegerT, typename Iter,
+          std::enable_if_t<std::is_integral<IntegerT>::value>* = nullptr>
+void
+urngfromflip_n(const IntegerT& a, const IntegerT& b, Iter first, Iter last)
+{
+    urngfromflip_n(a, b, first, last, thread_bit_source<>());
+}
+
+// urngfromflip_fdr returns a random integer in the range [a, b] using the
+// Fast Dice Roller of (Lumbroso, 2013), which consumes close to the minimum
+// number of flips by recycling the entropy left over from rejected draws.
+template <typename IntegerT, typename FlipFn,
+          std::enable_if_t<std::is_integral<IntegerT>::value>* = nullptr>
+IntegerT
+urngfromflip_fdr(const IntegerT& a, const IntegerT& b, FlipFn&& flip_fn)
+{
+    using T = std::uint64_t;
+    static constexpr T half = T{1} << 63;
+    // Compute the number of values in the range.
+    T n = static_cast<T>(b-a) + 1;
+
+    // Doubling v below would overflow for ranges of more than 2^63 values,
+    // where plain rejection of 64 bit draws succeeds at least half the time.
+    if (n == 0 || n > half) {
+        T urng;
+        do {
+            urng = 0;
+            for (std::size_t pos = 0; pos < 64; ++pos) {
+                urng = urng | (static_cast<T>(flip_fn())<<pos);
+            }
+        } while (n != 0 && urng >= n);
+        return a + static_cast<IntegerT>(urng);
+    }
+
+    // Invariant: c is uniformly distributed over [0, v).
+    T v = 1, c = 0;
+    while (true) {
+        // Append one flip to both v and c.
+        v = 2*v;
+        c = 2*c + flip_fn();
+        if (v >= n) {
+            if (c < n) {
+                return a + static_cast<IntegerT>(c);
+            }
+            // Keep c uniform over the leftover [0, v-n) for the next round.
+            v -= n;
+            c -= n;
+        }
+    }
+}
+
+// urngfromflip_fdr returns a random integer in the range [a, b] using the
+// flips of source.
+template <typename IntegerT, typename Engine,
+          std::enable_if_t<std::is_integral<IntegerT>::value>* = nullptr>
+IntegerT
+urngfromflip_fdr(const IntegerT& a, const IntegerT& b,
+                 BitSource<Engine>& source)
+{
+    return urngfromflip_fdr(a, b, [&source]() { return source.flip(); });
+}
+
+// urngfromflip_fdr returns a random integer in the range [a, b] using flip.
+template <typename IntegerT, typename Engine=std::mt19937_64,
+          std::enable_if_t<std::is_integral<IntegerT>::value>* = nullptr>
+IntegerT
+urngfromflip_fdr(const IntegerT& a, const IntegerT& b)
+{
+    return urngfromflip_fdr(a, b, thread_bit_source<Engine>());
+}
+
+// mul64 returns the high and low 64 bits of the 128 bit product x*y.
+std::pair<std::uint64_t, std::uint64_t>
+mul64(std::uint64_t x, std::uint64_t y)
+{
+    // Multiply 32 bit halves, which cannot overflow 64 bits.
+    static constexpr std::uint64_t lo32 = 0xffffffff;
+    std::uint64_t xlo = x & lo32, xhi = x >> 32;
+    std::uint64_t ylo = y & lo32, yhi = y >> 32;
+    std::uint64_t ll = xlo*ylo, lh = xlo*yhi, hl = xhi*ylo, hh = xhi*yhi;
+    std::uint64_t mid = (ll >> 32) + (lh & lo32) + (hl & lo32);
+    std::uint64_t hi = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+    std::uint64_t lo = (mid << 32) | (ll & lo32);
+    return {hi, lo};
+}
+
+// urngfromword returns a random integer in the range [a, b] from uniformly
+// distributed 64 bit words using the multiply and shift method of
+// (Lemire, 2019), which only divides in the rare case of a rejection.
+template <typename IntegerT, typename WordFn,
+          std::enable_if_t<std::is_integral<IntegerT>::value>* = nullptr>
+IntegerT
+urngfromword(const IntegerT& a, const IntegerT& b, WordFn&& next_word)
+{
+    using T = std::uint64_t;
+    // Compute the number of values in the range.
+    T n = static_cast<T>(b-a) + 1;
+    if (n == 0) {
+        return a + static_cast<IntegerT>(next_word());  // Every word.
+    }
+
+    // The high word of x*n is uniform over [0, n) unless the low word falls
+    // among the 2^64 mod n values which are over represented.
+    auto m = mul64(next_word(), n);
+    if (m.second < n) {
+        T threshold = (T{0}-n) % n;  // 2^64 mod n.
+        while (m.second < threshold) {
+            m = mul64(next_word(), n);
+        }
+    }
+    return a + static_cast<IntegerT>(m.first);
+}
+
 // chisq bins integers x and computes the chisq statistic based on a, b.
 template <typename T>
 double
@@ -69,6 +491,44 @@ chisq(const std::vector<T>& x, T a, T b)
     return chisq;
 }
 
+// require_uniform requires that 1000 integers in [1, 100] written by
+// fill(a, b, first, last) do not reject the null hypothesis H0 that they are
+// from a uniform distribution at P=0.001.
+template <typename Fill>
+void
+require_uniform(Fill&& fill)
+{
+    using T = std::uint8_t;
+
+    // Simulation parameters.
+    T a = 1, b = 100;
+    std::size_t nsamples = 1000;
+
+    // Collect random samples.
+    std::vector<T> randx(nsamples, T{0});
+    fill(a, b, std::begin(randx), std::end(randx));
+
+    // Compute the chisq statistic and compare to pvalue.
+    double chisqx = chisq(randx, a, b);
+    int df = b-a; // 99
+    constexpr double pvalue = 148.21; // P=0.001
+    CAPTURE(a, b, nsamples, df, chisqx, pvalue);
+    // Null hypothesis H0 is that numbers are from uniform distribution.
+    // When chisqx <= pvalue, then we fail to reject the null hypothesis.
+    REQUIRE(chisqx <= pvalue);
+}
+
+// each returns a fill function for require_uniform which draws each
+// integer with sample(a, b).
+template <typename Sample>
+auto
+each(Sample sample)
+{
+    return [sample](auto a, auto b, auto first, auto last) {
+        std::generate(first, last, [&]() { return sample(a, b); });
+    };
+}
+
 TEST_CASE("examples", "[urngfromflip]")
 {
     using T = std::uint32_t;
@@ -81,7 +541,11 @@ TEST_CASE("examples", "[urngfromflip]")
 
     std::vector<test_case> test_cases{
         { 0, 255 },
-        { 100, 110 }
+        { 100, 110 },
+        // Corner cases where the range is 0 or a power of 2.
+        { 7, 7 },
+        { 0, 1 },
+        { 0, 256 }
     };
 
     // Test parameters.
@@ -96,29 +560,245 @@ TEST_CASE("examples", "[urngfromflip]")
             REQUIRE(inrange == true);
             --repeat;
         } while (repeat > std::size_t{0});
+
+        std::vector<T> rcv(num_tests*1000);
+        urngfromflip_n(c.a, c.b, std::begin(rcv), std::end(rcv));
+        CAPTURE(c.a, c.b, rcv);
+        auto minmax = std::minmax_element(std::begin(rcv), std::end(rcv));
+        // Both bounds are returned with overwhelming probability.
+        REQUIRE(*minmax.first == c.a);
+        REQUIRE(*minmax.second == c.b);
     }
 }
 
+TEST_CASE("bit_width", "[urngfromflip]")
+{
+    REQUIRE(bit_width(0) == 0);
+    REQUIRE(bit_width(1) == 1);
+    REQUIRE(bit_width(2) == 2);
+    REQUIRE(bit_width(255) == 8);
+    REQUIRE(bit_width(256) == 9);
+    REQUIRE(bit_width(~std::uint64_t{0}) == 64);
+}
+
 TEST_CASE("chisq", "[urngfromflip]")
 {
-    using T = std::uint8_t;
+    require_uniform(each([](auto a, auto b) { return urngfromflip(a, b); }));
+}
 
-    // Simulation parameters.
-    T a = 1, b = 100;
-    std::size_t nsamples = 1000;
+TEST_CASE("chisq batched", "[urngfromflip]")
+{
+    // Collect random samples from sources which buffer 32 and 64 bits.
+    BitSource<std::mt19937> source32;
+    BitSource<std::mt19937_64> source64;
+    require_uniform([&source32](auto a, auto b, auto first, auto last) {
+        urngfromflip_n(a, b, first, last, source32);
+    });
+    require_uniform([&source64](auto a, auto b, auto first, auto last) {
+        urngfromflip_n(a, b, first, last, source64);
+    });
+}
 
-    // Collect random samples.
-    std::vector<T> randx(nsamples, T{0});
+TEST_CASE("fast dice roller", "[urngfromflip]")
+{
+    using T = std::uint64_t;
+
+    // Corner cases where the range is 0, a power of 2, or every integer.
+    REQUIRE(urngfromflip_fdr(T{7}, T{7}) == 7);
+    BitSource<> source;
+    auto next_word = [&source]() { return source.bits(64); };
+    REQUIRE(urngfromword(T{7}, T{7}, next_word) == 7);
+    for (std::size_t repeat = 0; repeat < 100; ++repeat) {
+        REQUIRE(urngfromflip_fdr(T{0}, T{1}) <= 1);
+        REQUIRE(urngfromword(T{0}, T{256}, next_word) <= 256);
+        urngfromflip_fdr(T{0}, ~T{0});
+        urngfromflip_fdr(T{0}, (T{1}<<63)+1);
+        urngfromword(T{0}, ~T{0}, next_word);
+    }
+
+    // Fast dice roller uses fewer than lg2 n + 2 flips on average, where
+    // rejection would use 9 flips per attempt and accept 257/512 of them.
+    std::size_t nflips = 0, nsamples = 10000;
+    auto counting_flip = [&nflips]() { ++nflips; return flip(); };
     for (std::size_t i = 0; i < nsamples; ++i) {
-        randx[i] = urngfromflip(a, b);
+        auto rcv = urngfromflip_fdr(T{0}, T{256}, counting_flip);
+        REQUIRE(rcv <= 256);
     }
+    double mean_flips = static_cast<double>(nflips)/nsamples;
+    CAPTURE(mean_flips);
+    REQUIRE(mean_flips < 10.0);
+}
 
-    // Compute the chisq statistic and compare to pvalue.
-    double chisqx = chisq(randx, a, b);
-    int df = b-a; // 99
-    constexpr double pvalue = 148.21; // P=0.001
-    CAPTURE(a, b, nsamples, df, chisqx, pvalue);
-    // Null hypothesis H0 is that numbers are from uniform distribution.
-    // When chisqx <= pvalue, then we fail to reject the null hypothesis.
-    REQUIRE(chisqx <= pvalue);
+TEST_CASE("chisq fdr and lemire", "[urngfromflip]")
+{
+    BitSource<> source;
+    auto next_word = [&source]() { return source.bits(64); };
+    require_uniform(each([](auto a, auto b) {
+        return urngfromflip_fdr(a, b);
+    }));
+    require_uniform(each([&next_word](auto a, auto b) {
+        return urngfromword(a, b, next_word);
+    }));
+}
+
+TEST_CASE("mul64", "[urngfromflip]")
+{
+    using T = std::uint64_t;
+    REQUIRE(mul64(0, ~T{0}) == std::make_pair(T{0}, T{0}));
+    REQUIRE(mul64(T{1}<<32, T{1}<<32) == std::make_pair(T{1}, T{0}));
+    REQUIRE(mul64(~T{0}, ~T{0}) == std::make_pair(~T{0}-1, T{1}));
+    REQUIRE(mul64(0x123456789abcdef0, 0x10)
+            == std::make_pair(T{0x1}, T{0x23456789abcdef00}));
+}
+
+TEST_CASE("xoshiro256pp", "[urngfromflip]")
+{
+    // Generators with the same seed and stream produce the same outputs.
+    Xoshiro256pp gen1(42), gen2(42), gen3(43);
+    std::vector<std::uint64_t> out1(100), out2(100), out3(100);
+    std::generate(std::begin(out1), std::end(out1), std::ref(gen1));
+    std::generate(std::begin(out2), std::end(out2), std::ref(gen2));
+    std::generate(std::begin(out3), std::end(out3), std::ref(gen3));
+    REQUIRE(out1 == out2);
+    REQUIRE(out1 != out3);
+
+    // Streams of one seed are reproducible and differ from each other.
+    REQUIRE(Xoshiro256pp::stream(42, 3).state()
+            == Xoshiro256pp::stream(42, 3).state());
+    REQUIRE(Xoshiro256pp::stream(42, 3).state()
+            != Xoshiro256pp::stream(42, 2).state());
+    REQUIRE(Xoshiro256pp::stream(42, 0).state() == Xoshiro256pp(42).state());
+
+    // Each lane of the vectorized generator is a scalar generator advanced
+    // by one jump more than the lane before it.
+    Xoshiro256ppx4 genx4(42);
+    std::vector<Xoshiro256pp> lanes(Xoshiro256ppx4::lanes, Xoshiro256pp(42));
+    for (std::size_t lane = 0; lane < lanes.size(); ++lane) {
+        for (std::size_t i = 0; i < lane; ++i) {
+            lanes[lane].jump();
+        }
+    }
+    for (std::size_t k = 0; k < 1000; ++k) {
+        auto lane = k % Xoshiro256ppx4::lanes;
+        CAPTURE(k);
+        REQUIRE(genx4() == lanes[lane]());
+    }
+}
+
+TEST_CASE("chisq xoshiro", "[urngfromflip]")
+{
+    require_uniform(each([](auto a, auto b) {
+        return urngfromflip<decltype(a), Xoshiro256pp>(a, b);
+    }));
+    require_uniform(each([](auto a, auto b) {
+        return urngfromflip<decltype(a), Xoshiro256ppx4>(a, b);
+    }));
+}
+
+TEST_CASE("reproducible streams", "[urngfromflip]")
+{
+    using T = std::uint32_t;
+
+    T a = 1, b = 1000;
+    std::size_t nsamples = 100;
+    std::uint64_t seed = 42;
+
+    // run draws from each function using a caller owned source.
+    auto run = [=](std::size_t id) {
+        BitSource<Xoshiro256pp> source(Xoshiro256pp::stream(seed, id));
+        std::vector<T> rcv(3*nsamples);
+        for (std::size_t i = 0; i < nsamples; ++i) {
+            rcv[i] = urngfromflip(a, b, source);
+            rcv[nsamples+i] = urngfromflip_fdr(a, b, source);
+        }
+        urngfromflip_n(a, b, std::begin(rcv)+2*nsamples, std::end(rcv),
+                       source);
+        return rcv;
+    };
+    REQUIRE(run(0) == run(0));
+    REQUIRE(run(1) == run(1));
+    REQUIRE(run(0) != run(1));
+
+    // run_thread draws from the thread local source of a new thread after
+    // seeding it with a stream of seed.
+    auto run_thread = [=](std::size_t id) {
+        std::vector<T> rcv(2*nsamples);
+        std::thread thread([&]() {
+            seed_flip(Xoshiro256pp::stream(seed, id));
+            for (std::size_t i = 0; i < nsamples; ++i) {
+                rcv[i] = urngfromflip<T, Xoshiro256pp>(a, b);
+                rcv[nsamples+i] = urngfromflip_fdr<T, Xoshiro256pp>(a, b);
+            }
+        });
+        thread.join();
+        return rcv;
+    };
+    REQUIRE(run_thread(0) == run_thread(0));
+    REQUIRE(run_thread(0) != run_thread(1));
+
+    // A seeded thread local source yields the same flips as a caller owned
+    // source with the same engine.
+    seed_flip(Xoshiro256pp::stream(seed, 2));
+    BitSource<Xoshiro256pp> source(Xoshiro256pp::stream(seed, 2));
+    for (std::size_t i = 0; i < 1000; ++i) {
+        REQUIRE(flip<Xoshiro256pp>() == source.flip());
+    }
+}
+
+TEST_CASE("benchmark", "[.benchmark][urngfromflip]")
+{
+    using T = std::uint32_t;
+
+    // A range just above a power of 2 is the worst case for rejection.
+    T a = 0, b = 256;
+    BitSource<> source;
+    auto next_word = [&source]() { return source.bits(64); };
+
+    BENCHMARK("urngfromflip")
+    {
+        return urngfromflip(a, b);
+    };
+
+    BENCHMARK("urngfromflip_n")
+    {
+        T x;
+        urngfromflip_n(a, b, &x, &x+1, source);
+        return x;
+    };
+
+    BENCHMARK("urngfromflip_fdr")
+    {
+        return urngfromflip_fdr(a, b);
+    };
+
+    BENCHMARK("urngfromword")
+    {
+        return urngfromword(a, b, next_word);
+    };
+}
+
+TEST_CASE("engine benchmark", "[.benchmark][urngfromflip]")
+{
+    std::vector<std::uint64_t> out(1024);
+
+    std::mt19937_64 mt(42);
+    BENCHMARK("mt19937_64")
+    {
+        std::generate(std::begin(out), std::end(out), std::ref(mt));
+        return out.back();
+    };
+
+    Xoshiro256pp gen(42);
+    BENCHMARK("Xoshiro256pp")
+    {
+        std::generate(std::begin(out), std::end(out), std::ref(gen));
+        return out.back();
+    };
+
+    Xoshiro256ppx4 genx4(42);
+    BENCHMARK("Xoshiro256ppx4::fill")
+    {
+        genx4.fill(out.data(), out.size());
+        return out.back();
+    };
 }
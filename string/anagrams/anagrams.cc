@@ -1,11 +1,26 @@
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
+#include <istream>
 #include <iterator>
+#include <numeric>
+#include <optional>
+#include <ostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <tuple>
 #include <unordered_map>
 #include <vector>
 
-// Let Catch provide main().
+// Let Catch provide main() and benchmarks.
 #define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
 #include "catch2/catch.hpp"
 
 // anagrams returns vector of indices of start of anagrams of s in word.
@@ -93,6 +108,450 @@ anagrams(const std::string& word, const std::string s)
     return matches;
 }
 
+// AnagramStream finds anagrams of s in input which arrives in blocks.
+//
+// Only the last s.size() characters of input are retained between blocks
+// so that arbitrarily large input can be scanned in constant memory.
+class AnagramStream
+{
+  public:
+    explicit AnagramStream(const std::string& s)
+        : window_(s.size(), '\0')
+    {
+        // Initialize the frequency table with characters from s using the
+        // same invariants as the map in anagrams.
+        for (const auto c : s) {
+            bump(c, +1);
+        }
+    }
+
+    // update consumes [first, first+len) and invokes on_match with the
+    // absolute offset of the start of each anagram found in the input.
+    template <typename Callback>
+    void update(const char* first, std::size_t len, Callback&& on_match)
+    {
+        const std::size_t m = window_.size();
+        if (m == 0) {
+            return;  // Edge case.
+        }
+        for (const char* p = first; p != first + len; ++p) {
+            // Slot in window holding the character which leaves the window.
+            auto& slot = window_[pos_ % m];
+            if (pos_ >= m) {
+                bump(slot, +1);  // Increment means not found in window.
+            }
+            bump(*p, -1);  // Decrement means found in window.
+            slot = *p;
+            ++pos_;
+            // Check whether the window holds an anagram.
+            if (pos_ >= m && nonzero_ == 0) {
+                on_match(pos_ - m);
+            }
+        }
+    }
+
+    // consumed returns the number of characters consumed so far.
+    std::size_t consumed() const
+    {
+        return pos_;
+    }
+
+  private:
+    // bump adds delta to frequency of c and tracks count of nonzero entries.
+    void bump(char c, int delta)
+    {
+        auto& freq = wfreq_[static_cast<unsigned char>(c)];
+        if (freq == 0) {
+            ++nonzero_;
+        }
+        freq += delta;
+        if (freq == 0) {
+            --nonzero_;
+        }
+    }
+
+    // wfreq_ is the character frequency table indexed by character.
+    std::array<int, 256> wfreq_{};
+
+    // nonzero_ counts entries of wfreq_ which are not 0-valued.
+    std::size_t nonzero_{0};
+
+    // window_ is a ring buffer holding the last s.size() characters.
+    std::string window_;
+
+    // pos_ is the absolute offset of the next character to consume.
+    std::size_t pos_{0};
+};
+
+// anagrams_stream invokes on_match with the offset of each anagram of s in
+// the contiguous region [first, first+len), e.g. a memory mapped file.
+template <typename Callback>
+void
+anagrams_stream(const char* first, std::size_t len,
+                const std::string& s, Callback&& on_match)
+{
+    AnagramStream stream(s);
+    stream.update(first, len, on_match);
+}
+
+// anagrams_stream invokes on_match with the offset of each anagram of s in
+// the input stream is, reading at most block_size characters at a time.
+template <typename Callback>
+void
+anagrams_stream(std::istream& is, const std::string& s,
+                Callback&& on_match, std::size_t block_size=1<<16)
+{
+    AnagramStream stream(s);
+    std::vector<char> block(block_size);
+    while (is) {
+        is.read(block.data(), block.size());
+        stream.update(block.data(), static_cast<std::size_t>(is.gcount()),
+                      on_match);
+    }
+}
+
+// Signature is the character frequency of a word packed into 128 bits.
+//
+// Each of the letters a-z is given a 4-bit count so that two words are
+// anagrams of each other exactly when their signatures are equal.
+struct Signature
+{
+    std::uint64_t lo;  // Counts of letters a-p.
+    std::uint64_t hi;  // Counts of letters q-z.
+
+    bool operator==(const Signature& rhs) const
+    {
+        return lo == rhs.lo && hi == rhs.hi;
+    }
+};
+
+// signature returns the signature of word or nullopt when word contains a
+// character outside of a-z or any letter appears more than 15 times.
+std::optional<Signature>
+signature(std::string_view word)
+{
+    std::array<std::uint8_t, 26> freq{};
+    for (const auto c : word) {
+        if (c < 'a' || c > 'z' || ++freq[c-'a'] > 15) {
+            return std::nullopt;
+        }
+    }
+    Signature sig{0, 0};
+    for (std::size_t i = 0; i < 16; ++i) {
+        sig.lo |= static_cast<std::uint64_t>(freq[i]) << (4*i);
+    }
+    for (std::size_t i = 16; i < freq.size(); ++i) {
+        sig.hi |= static_cast<std::uint64_t>(freq[i]) << (4*(i-16));
+    }
+    return sig;
+}
+
+struct AnagramIndexError : std::runtime_error
+{
+    using std::runtime_error::runtime_error;
+};
+
+// AnagramIndex answers which dictionary words are anagrams of a query.
+//
+// The index is a single flat buffer so that it can be written to a file and
+// later used in place from a memory mapped region without any parsing.
+// The buffer consists of the following 8-byte aligned sections:
+// * Header  : magic, number of slots, number of words, size of text.
+// * Slots   : open addressing hash table of (signature, first, count).
+// * Offsets : nwords+1 offsets into text with anagrams stored contiguously.
+// * Text    : concatenated characters of all words.
+class AnagramIndex
+{
+  public:
+    // Copies are disallowed since sections point into the owned buffer.
+    AnagramIndex(const AnagramIndex&) = delete;
+    AnagramIndex& operator=(const AnagramIndex&) = delete;
+    AnagramIndex(AnagramIndex&&) = default;
+    AnagramIndex& operator=(AnagramIndex&&) = default;
+
+    // build returns an index over words.
+    static AnagramIndex build(const std::vector<std::string>& words)
+    {
+        // Offsets and slots hold 32-bit word indices and text offsets.
+        std::uint64_t ntext = 0;
+        for (const auto& w : words) {
+            ntext += w.size();
+        }
+        if (words.size() >= UINT32_MAX || ntext > UINT32_MAX) {
+            throw AnagramIndexError("too many words to index");
+        }
+
+        // Compute the signature of every word.
+        std::vector<Signature> sigs;
+        sigs.reserve(words.size());
+        for (const auto& w : words) {
+            auto sig = signature(w);
+            if (!sig) {
+                throw AnagramIndexError("word is not indexable: " + w);
+            }
+            sigs.emplace_back(*sig);
+        }
+
+        // Order words by signature so that anagrams are contiguous.
+        std::vector<std::uint32_t> order(words.size());
+        std::iota(std::begin(order), std::end(order), 0);
+        std::sort(std::begin(order), std::end(order),
+            [&sigs](std::uint32_t lhs, std::uint32_t rhs) {
+                return std::tie(sigs[lhs].hi, sigs[lhs].lo)
+                    < std::tie(sigs[rhs].hi, sigs[rhs].lo);
+            }
+        );
+
+        // Count the number of distinct signatures to size the table.
+        std::size_t ngroups = 0;
+        for (std::size_t i = 0; i < order.size(); ++i) {
+            if (i == 0 || !(sigs[order[i]] == sigs[order[i-1]])) {
+                ++ngroups;
+            }
+        }
+        // Keep the load factor at or below 1/2 with a power of 2 size.
+        std::uint64_t nslots = 2;
+        while (nslots < 2*ngroups) {
+            nslots *= 2;
+        }
+
+        Header header{magic, nslots, words.size(), ntext};
+        AnagramIndex index;
+        index.owned_.resize(layout_size(nslots, words.size(), ntext));
+        std::memcpy(index.owned_.data(), &header, sizeof(header));
+        index.attach(reinterpret_cast<const char*>(index.owned_.data()),
+                     index.owned_.size()*sizeof(std::uint64_t), header);
+
+        // Copy the text and offsets, inserting a slot for each group.
+        auto slots = const_cast<Slot*>(index.slots_);
+        auto offsets = const_cast<std::uint32_t*>(index.offsets_);
+        auto text = const_cast<char*>(index.text_);
+        std::uint32_t offset = 0;
+        for (std::size_t i = 0; i < order.size(); ++i) {
+            const auto& sig = sigs[order[i]];
+            if (i == 0 || !(sig == sigs[order[i-1]])) {
+                auto& slot = slots[index.probe(sig)];
+                slot = Slot{sig, static_cast<std::uint32_t>(i), 0};
+            }
+            ++slots[index.probe(sig)].count;
+            const auto& w = words[order[i]];
+            offsets[i] = offset;
+            std::memcpy(text+offset, w.data(), w.size());
+            offset += w.size();
+        }
+        offsets[order.size()] = offset;
+
+        return index;
+    }
+
+    // view returns an index which refers to a buffer previously obtained
+    // from data(), e.g. a memory mapped file. The buffer must outlive the
+    // index and be 8-byte aligned.
+    static AnagramIndex view(const char* data, std::size_t size)
+    {
+        if (reinterpret_cast<std::uintptr_t>(data) % alignof(Header) != 0) {
+            throw AnagramIndexError("buffer is not aligned");
+        }
+        if (size < sizeof(Header)) {
+            throw AnagramIndexError("buffer is truncated");
+        }
+        Header header;
+        std::memcpy(&header, data, sizeof(header));
+        if (header.magic != magic) {
+            throw AnagramIndexError("buffer is not an anagram index");
+        }
+        check_header(header);
+        auto nwords = layout_size(header.nslots, header.nwords, header.ntext);
+        if (size < nwords*sizeof(std::uint64_t)) {
+            throw AnagramIndexError("buffer is truncated");
+        }
+        AnagramIndex index;
+        index.attach(data, size, header);
+        index.check(header);
+        return index;
+    }
+
+    // load returns an index read from is which was written by save.
+    static AnagramIndex load(std::istream& is)
+    {
+        Header header;
+        if (!is.read(reinterpret_cast<char*>(&header), sizeof(header))
+            || header.magic != magic) {
+            throw AnagramIndexError("stream is not an anagram index");
+        }
+        check_header(header);
+
+        // Grow the buffer as the sections are read rather than allocating
+        // the size given by the header up front, so that a corrupt header
+        // fails with a short read instead of a huge allocation.
+        constexpr std::size_t chunk = 1 << 17;  // 1 MiB in units of 8 bytes.
+        auto nbuf = layout_size(header.nslots, header.nwords, header.ntext);
+        AnagramIndex index;
+        index.owned_.resize(sizeof(header)/sizeof(std::uint64_t));
+        std::memcpy(index.owned_.data(), &header, sizeof(header));
+        while (index.owned_.size() < nbuf) {
+            auto pos = index.owned_.size();
+            auto n = std::min(chunk, nbuf - pos);
+            index.owned_.resize(pos + n);
+            if (!is.read(reinterpret_cast<char*>(index.owned_.data() + pos),
+                         n*sizeof(std::uint64_t))) {
+                throw AnagramIndexError("stream is truncated");
+            }
+        }
+        auto buf = reinterpret_cast<const char*>(index.owned_.data());
+        index.attach(buf, nbuf*sizeof(std::uint64_t), header);
+        index.check(header);
+        return index;
+    }
+
+    // save writes the index to os.
+    void save(std::ostream& os) const
+    {
+        os.write(data_, size_);
+    }
+
+    // data returns the flat buffer which holds the index.
+    const char* data() const
+    {
+        return data_;
+    }
+
+    // size returns the size of the flat buffer in bytes.
+    std::size_t size() const
+    {
+        return size_;
+    }
+
+    // lookup returns the dictionary words which are anagrams of word.
+    std::vector<std::string_view> lookup(std::string_view word) const
+    {
+        std::vector<std::string_view> matches;
+        auto sig = signature(word);
+        if (!sig) {
+            return matches;  // No indexed word has an invalid signature.
+        }
+        // The load factor guarantees the probe stops at an empty slot.
+        const auto& slot = slots_[probe(*sig)];
+        matches.reserve(slot.count);
+        for (std::uint32_t i = slot.first; i < slot.first+slot.count; ++i) {
+            matches.emplace_back(text_+offsets_[i], offsets_[i+1]-offsets_[i]);
+        }
+        return matches;
+    }
+
+  private:
+    static constexpr std::uint64_t magic = 0x5844494d47414e41;  // ANAGMIDX
+
+    struct Header
+    {
+        std::uint64_t magic;
+        std::uint64_t nslots;
+        std::uint64_t nwords;
+        std::uint64_t ntext;
+    };
+
+    // Slot is an entry in the hash table, empty when count is 0.
+    struct Slot
+    {
+        Signature sig;
+        std::uint32_t first;  // Index into offsets of the first anagram.
+        std::uint32_t count;  // Number of anagrams.
+    };
+
+    AnagramIndex() = default;
+
+    // check_header throws unless the header describes sections which fit
+    // 32-bit word indices and text offsets, and a table which probe can
+    // address and which is no larger than build would make it.
+    static void check_header(const Header& header)
+    {
+        constexpr std::uint64_t max32 = UINT32_MAX;
+        if (header.nwords >= max32 || header.ntext > max32) {
+            throw AnagramIndexError("anagram index is too large");
+        }
+        // build uses the smallest power of 2 of at least 2 slots per group.
+        if (header.nslots == 0
+            || (header.nslots & (header.nslots-1)) != 0
+            || header.nslots > std::max<std::uint64_t>(2, 4*header.nwords)) {
+            throw AnagramIndexError("anagram index has invalid table size");
+        }
+    }
+
+    // check throws unless the sections attached for header are consistent,
+    // so that probe terminates and lookup stays within the buffer.
+    void check(const Header& header) const
+    {
+        bool has_empty = false;
+        for (std::uint64_t i = 0; i < header.nslots; ++i) {
+            const auto& slot = slots_[i];
+            has_empty = has_empty || slot.count == 0;
+            if (std::uint64_t{slot.first} + slot.count > header.nwords) {
+                throw AnagramIndexError("anagram index slot is corrupt");
+            }
+        }
+        if (!has_empty) {
+            throw AnagramIndexError("anagram index table is full");
+        }
+        for (std::uint64_t i = 0; i < header.nwords; ++i) {
+            if (offsets_[i] > offsets_[i+1]) {
+                throw AnagramIndexError("anagram index offsets are corrupt");
+            }
+        }
+        if (offsets_[header.nwords] > header.ntext) {
+            throw AnagramIndexError("anagram index offsets are corrupt");
+        }
+    }
+
+    // layout_size returns the size of the buffer in units of 8 bytes.
+    static std::size_t layout_size(std::uint64_t nslots, std::uint64_t nwords,
+                                   std::uint64_t ntext)
+    {
+        auto words = [](std::uint64_t nbytes) { return (nbytes+7)/8; };
+        return words(sizeof(Header))
+            + words(nslots*sizeof(Slot))
+            + words((nwords+1)*sizeof(std::uint32_t))
+            + words(ntext);
+    }
+
+    // attach points the sections of the index into the buffer at data.
+    void attach(const char* data, std::size_t size, const Header& header)
+    {
+        auto round = [](std::uint64_t nbytes) { return (nbytes+7)/8*8; };
+        data_ = data;
+        size_ = size;
+        mask_ = header.nslots-1;
+        data += round(sizeof(Header));
+        slots_ = reinterpret_cast<const Slot*>(data);
+        data += round(header.nslots*sizeof(Slot));
+        offsets_ = reinterpret_cast<const std::uint32_t*>(data);
+        data += round((header.nwords+1)*sizeof(std::uint32_t));
+        text_ = data;
+    }
+
+    // probe returns the slot holding sig or the empty slot where it belongs.
+    std::size_t probe(const Signature& sig) const
+    {
+        // Mix both halves of the signature and keep the upper bits.
+        std::uint64_t h = (sig.lo ^ (sig.hi * 0x9e3779b97f4a7c15))
+            * 0xbf58476d1ce4e5b9;
+        std::size_t i = (h ^ (h >> 31)) & mask_;
+        while (slots_[i].count != 0 && !(slots_[i].sig == sig)) {
+            i = (i+1) & mask_;  // Linear probe.
+        }
+        return i;
+    }
+
+    // owned_ holds the buffer unless the index is a view.
+    std::vector<std::uint64_t> owned_;
+
+    const char* data_{nullptr};
+    std::size_t size_{0};
+    std::size_t mask_{0};
+    const Slot* slots_{nullptr};
+    const std::uint32_t* offsets_{nullptr};
+    const char* text_{nullptr};
+};
+
 TEST_CASE("examples", "[anagrams]")
 {
     struct test_case
@@ -135,3 +594,190 @@ TEST_CASE("examples", "[anagrams]")
         REQUIRE(rcv == c.expected_indices);
     }
 }
+
+TEST_CASE("stream", "[anagrams]")
+{
+    std::mt19937 gen{std::random_device{}()};
+    std::uniform_int_distribution<int> dis('a', 'd');
+
+    // Random words over a small alphabet produce many overlapping anagrams.
+    std::string word(1000, ' ');
+    for (auto& c : word) {
+        c = static_cast<char>(dis(gen));
+    }
+
+    for (const std::string s : {"a", "ab", "abca", "ddcab", "abcdabcd"}) {
+        auto expected = anagrams(word, s);
+
+        // Feed the word in blocks of varying size.
+        for (std::size_t block_size : {1, 2, 3, 7, 64, 4096}) {
+            CAPTURE(s, block_size);
+            std::vector<std::size_t> rcv;
+            auto on_match = [&rcv](std::size_t i) { rcv.emplace_back(i); };
+
+            AnagramStream stream(s);
+            for (std::size_t i = 0; i < word.size(); i += block_size) {
+                auto len = std::min(block_size, word.size()-i);
+                stream.update(word.data()+i, len, on_match);
+            }
+            REQUIRE(stream.consumed() == word.size());
+            REQUIRE(rcv == expected);
+
+            rcv.clear();
+            std::istringstream is(word);
+            anagrams_stream(is, s, on_match, block_size);
+            REQUIRE(rcv == expected);
+        }
+
+        std::vector<std::size_t> rcv;
+        anagrams_stream(word.data(), word.size(), s,
+                        [&rcv](std::size_t i) { rcv.emplace_back(i); });
+        REQUIRE(rcv == expected);
+    }
+}
+
+TEST_CASE("index", "[anagrams]")
+{
+    std::vector<std::string> words{
+        "abode", "adobe", "alert", "alter", "later", "stop", "pots", "tops",
+        "opts", "post", "spot", "dog", "god", "cat", "act", "tac", "abc",
+        "a", "aa", "evil", "live", "vile", "veil", "zzz", "dog"
+    };
+    auto index = AnagramIndex::build(words);
+
+    // Brute force compares sorted letters of every word.
+    auto brute_force = [&words](std::string query) {
+        std::sort(std::begin(query), std::end(query));
+        std::vector<std::string> matches;
+        for (auto w : words) {
+            auto sorted_w = w;
+            std::sort(std::begin(sorted_w), std::end(sorted_w));
+            if (sorted_w == query) {
+                matches.emplace_back(w);
+            }
+        }
+        std::sort(std::begin(matches), std::end(matches));
+        return matches;
+    };
+    auto lookup = [](const AnagramIndex& index, const std::string& query) {
+        auto rcv = index.lookup(query);
+        std::vector<std::string> matches(std::begin(rcv), std::end(rcv));
+        std::sort(std::begin(matches), std::end(matches));
+        return matches;
+    };
+
+    // Reload the index from a stream and view it in place.
+    std::stringstream ss;
+    index.save(ss);
+    auto loaded = AnagramIndex::load(ss);
+    std::vector<std::uint64_t> mapped(index.size()/sizeof(std::uint64_t));
+    std::memcpy(mapped.data(), index.data(), index.size());
+    auto viewed = AnagramIndex::view(
+        reinterpret_cast<const char*>(mapped.data()), index.size());
+
+    std::vector<std::string> queries{
+        "odeab", "tlera", "stop", "ogd", "tca", "cab", "a", "aa", "aaa",
+        "vlie", "zz", "zzz", "none", "", "Dog", "x-y"
+    };
+    for (const auto& q : queries) {
+        CAPTURE(q);
+        auto expected = brute_force(q);
+        REQUIRE(lookup(index, q) == expected);
+        REQUIRE(lookup(loaded, q) == expected);
+        REQUIRE(lookup(viewed, q) == expected);
+    }
+
+    REQUIRE_THROWS_AS(AnagramIndex::build({"Capital"}), AnagramIndexError);
+    REQUIRE_THROWS_AS(AnagramIndex::view(ss.str().data(), 8),
+                      AnagramIndexError);
+}
+
+TEST_CASE("index corrupt", "[anagrams]")
+{
+    auto index = AnagramIndex::build({"dog", "god", "cat", "act", "tac"});
+
+    // magic_of returns the first 64-bit word of the index.
+    auto magic_of = [](const AnagramIndex& index) {
+        std::uint64_t magic;
+        std::memcpy(&magic, index.data(), sizeof(magic));
+        return magic;
+    };
+
+    // corrupt returns a copy of the index with the 64-bit word at position
+    // pos replaced by value.
+    auto corrupt = [&index](std::size_t pos, std::uint64_t value) {
+        std::vector<std::uint64_t> buf(index.size()/sizeof(std::uint64_t));
+        std::memcpy(buf.data(), index.data(), index.size());
+        buf[pos] = value;
+        return buf;
+    };
+    // require_rejected requires that view and load both reject buf.
+    auto require_rejected = [](const std::vector<std::uint64_t>& buf) {
+        auto data = reinterpret_cast<const char*>(buf.data());
+        auto size = buf.size()*sizeof(std::uint64_t);
+        REQUIRE_THROWS_AS(AnagramIndex::view(data, size), AnagramIndexError);
+        std::stringstream ss(std::string(data, size));
+        REQUIRE_THROWS_AS(AnagramIndex::load(ss), AnagramIndexError);
+    };
+
+    // The header holds magic, nslots, nwords and ntext.
+    constexpr std::size_t nslots = 1, nwords = 2, ntext = 3;
+    require_rejected(corrupt(nslots, 0));
+    require_rejected(corrupt(nslots, 3));
+    require_rejected(corrupt(nslots, std::uint64_t{1} << 62));
+    require_rejected(corrupt(nwords, ~std::uint64_t{0}));
+    require_rejected(corrupt(ntext, ~std::uint64_t{0}));
+
+    // A header which claims the largest sections allowed must not be
+    // trusted to size the buffer before the sections have been read.
+    auto huge = corrupt(nslots, std::uint64_t{1} << 32);
+    huge[nwords] = UINT32_MAX - 1;
+    huge[ntext] = UINT32_MAX;
+    require_rejected(huge);
+
+    // Each slot of 24 bytes follows the 32 byte header, with the first
+    // index and count of its anagrams in its last 8 bytes.
+    constexpr std::size_t slot0 = 4, slot_size = 3;
+    auto full = corrupt(0, magic_of(index));
+    for (std::uint64_t i = 0; i < full[nslots]; ++i) {
+        // Fill every slot so that no probe would find an empty slot.
+        full[slot0 + i*slot_size + 2] = std::uint64_t{1} << 32;
+    }
+    require_rejected(full);
+    require_rejected(corrupt(slot0 + 2, ~std::uint64_t{0}));
+    require_rejected(corrupt(0, 0));
+
+    // The index is intact without corruption.
+    auto intact = corrupt(0, magic_of(index));
+    auto viewed = AnagramIndex::view(
+        reinterpret_cast<const char*>(intact.data()), index.size());
+    REQUIRE(viewed.lookup("tca").size() == 3);
+}
+
+TEST_CASE("index benchmark", "[.benchmark][anagrams]")
+{
+    // Generate a dictionary of random words of length [3, 10].
+    std::mt19937 gen{42};
+    std::uniform_int_distribution<int> letter('a', 'z');
+    std::uniform_int_distribution<std::size_t> length(3, 10);
+    std::vector<std::string> words(500000);
+    for (auto& w : words) {
+        w.resize(length(gen));
+        for (auto& c : w) {
+            c = static_cast<char>(letter(gen));
+        }
+    }
+
+    BENCHMARK("build 500k words")
+    {
+        return AnagramIndex::build(words);
+    };
+
+    auto index = AnagramIndex::build(words);
+    std::size_t i = 0;
+    BENCHMARK("lookup")
+    {
+        i = (i+7919) % words.size();
+        return index.lookup(words[i]);
+    };
+}
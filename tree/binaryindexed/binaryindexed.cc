@@ -1,12 +1,27 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
 #include <type_traits>
 #include <tuple>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
-// Let Catch provide main().
+// Let Catch provide main() and benchmarks.
 #define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
 #include "catch2/catch.hpp"
 
 // BinaryIndexTree provides logarithmic add and cumsum operations without any
@@ -22,6 +37,39 @@ class BinaryIndexedTree
         : tree_(n+1)
     { }
 
+    // BinaryIndexedTree holds the samples in [first, last) as bins [1, n].
+    template <typename InputIt>
+    BinaryIndexedTree(InputIt first, InputIt last)
+    {
+        reset(first, last);
+    }
+
+    // reset replaces the bins with the samples in [first, last).
+    //
+    // Rather than n calls to add, which cost O(n log n), copy the samples
+    // into the tree and push each bin into its right parent in a single
+    // pass from left to right.  Each bin is complete once all of its
+    // children have been pushed into it, which happens before the pass
+    // reaches it since children precede parents, so this costs O(n).
+    template <typename InputIt>
+    void reset(InputIt first, InputIt last)
+    {
+        tree_.assign(1, T{0});
+        tree_.insert(std::end(tree_), first, last);
+        for (std::size_t ind = 1; ind < tree_.size(); ++ind) {
+            std::size_t parent = ind + (ind & (-ind));
+            if (parent < tree_.size()) {
+                tree_[parent] += tree_[ind];
+            }
+        }
+    }
+
+    // size returns the number of bins.
+    std::size_t size() const
+    {
+        return tree_.size()-1;
+    }
+
     // add increments the bin at t by x.
     void add(std::size_t t, T x)
     {
@@ -79,7 +127,535 @@ class BinaryIndexedTree
         return sum;
     }
 
+    // lower_bound returns the smallest t such that cumsum(1, t) >= value,
+    // or n+1 when no such t exists.  Bins must not be negative.
+    std::size_t lower_bound(T value) const
+    {
+        // Descend from the root by decreasing powers of 2, where pos is the
+        // largest index known to have cumsum(1, pos) < value.
+        //
+        // For example, assume n = 14d and the answer is 11d.
+        // Bin 8d holds the sum of [1, 8], which is < value, so pos = 8d.
+        // Bin 12d holds the sum of [9, 12], which is >= the remainder.
+        // Bin 10d holds the sum of [9, 10], which is < the remainder, so
+        // pos = 10d.
+        // Bin 11d holds the sum of [11, 11], which is >= the remainder.
+        // The answer is pos+1 = 11d.
+        std::size_t pos{0};
+        std::size_t step{1};
+        while (step*2 < tree_.size()) {
+            step *= 2;
+        }
+        for (; step > 0; step /= 2) {
+            if (pos+step < tree_.size() && tree_[pos+step] < value) {
+                pos += step;
+                value -= tree_[pos];
+            }
+        }
+        return pos+1;
+    }
+
+    // find_kth returns the bin holding the kth sample when bin t counts the
+    // samples equal to t, or n+1 when there are fewer than k samples.
+    std::size_t find_kth(T k) const
+    {
+        assert(k > 0); // k must start from 1.
+        return lower_bound(k);
+    }
+
+  private:
+    // tree_ holds the binary indexed tree as a flat array.
+    std::vector<T> tree_;
+};
+
+// RangeBinaryIndexedTree provides logarithmic range_add and range_sum
+// operations using two binary indexed trees.
+//
+// Adding x to each bin in [t0, t1] changes the prefix sum through bin t by
+//   0                   for t < t0,
+//   x*t - x*(t0-1)      for t0 <= t <= t1,
+//   x*t1 - x*(t0-1)     for t > t1.
+// The first tree holds the coefficient of t, adding x at t0 and -x at t1+1,
+// and the second holds the constant term, adding x*(t0-1) at t0 and -x*t1
+// at t1+1, so the prefix sum through t is cumsum1(t)*t - cumsum2(t).
+template <typename T,
+          std::enable_if_t<std::is_integral<T>::value>* = nullptr>
+class RangeBinaryIndexedTree
+{
+  public:
+
+    // RangeBinaryIndexedTree holds n samples from [1, n].
+    RangeBinaryIndexedTree(const std::size_t n)
+        : n_(n)
+        , slope_(n)
+        , offset_(n)
+    { }
+
+    // range_add increments each bin in [t0, t1] by x.
+    void range_add(std::size_t t0, std::size_t t1, T x)
+    {
+        assert(t0 > 0); // t0 must start from 1.
+        assert(t1 >= t0);
+        assert(t1 <= n_);
+
+        slope_.add(t0, x);
+        offset_.add(t0, x*static_cast<T>(t0-1));
+        if (t1 < n_) {
+            slope_.add(t1+1, -x);
+            offset_.add(t1+1, -x*static_cast<T>(t1));
+        }
+    }
+
+    // add increments the bin at t by x.
+    void add(std::size_t t, T x)
+    {
+        range_add(t, t, x);
+    }
+
+    // range_sum returns cumulative sum of bins from [t0, t1].
+    T range_sum(std::size_t t0, std::size_t t1) const
+    {
+        assert(t0 > 0); // t0 must start from 1.
+        assert(t1 >= t0);
+
+        return prefix_sum(t1) - prefix_sum(t0-1);
+    }
+
+  private:
+    // prefix_sum returns cumulative sum of bins from [1, t].
+    T prefix_sum(std::size_t t) const
+    {
+        if (t == 0) {
+            return T{0};
+        }
+        return slope_.cumsum(1, t)*static_cast<T>(t) - offset_.cumsum(1, t);
+    }
+
+    std::size_t n_;
+    BinaryIndexedTree<T> slope_;
+    BinaryIndexedTree<T> offset_;
+};
+
+// ConcurrentBinaryIndexedTree provides the add and cumsum operations of
+// BinaryIndexedTree to many threads at once without locks.
+//
+// Each add increments each bin it visits with a relaxed atomic fetch_add,
+// and each cumsum loads each bin it visits with a relaxed atomic load.
+// * Each bin is updated atomically, so no increment is ever lost, and once
+//   the adding threads have been joined, cumsum is exact.
+// * An add is not atomic as a whole, so a cumsum which runs concurrently
+//   may see some of the bins of an add but not others, and relaxed loads
+//   impose no order between adds to different bins.
+// * When every x is not negative, a prefix sum cumsum(1, t) is at least
+//   the sum of the adds which happen before it and at most the sum of the
+//   adds which do not happen after it, and successive prefix sums of the
+//   same t by the same thread never decrease.  Since the operations are
+//   relaxed, an add happens before a cumsum only when it was made by the
+//   same thread or is ordered by outside synchronization, such as joining
+//   the adding thread.  An add on another thread which merely finished
+//   earlier in time need not be seen.
+// * A range sum cumsum(t0, t1) with t0 > 1 is the difference of two prefix
+//   sums read at different times and has no such bound.  An add in
+//   [1, t0) may be seen by one prefix sum but not the other, so the range
+//   sum may be off by any concurrent add, may be negative, and successive
+//   range sums may decrease.
+template <typename T,
+          std::enable_if_t<std::is_integral<T>::value>* = nullptr>
+class ConcurrentBinaryIndexedTree
+{
+  public:
+
+    // ConcurrentBinaryIndexedTree holds n samples from [1, n].
+    ConcurrentBinaryIndexedTree(const std::size_t n)
+        : tree_(n+1)
+    {
+        for (auto& bin : tree_) {
+            bin.store(T{0}, std::memory_order_relaxed);
+        }
+    }
+
+    // add increments the bin at t by x.
+    void add(std::size_t t, T x)
+    {
+        assert(t > 0); // t must start from 1.
+
+        std::size_t ind{t};
+        while (ind < tree_.size()) {
+            tree_[ind].fetch_add(x, std::memory_order_relaxed);
+            ind += ind & (-ind); // Right parent one-level higher in tree.
+        }
+    }
+
+    // cumsum returns cumulative sum of bins from [t0, t1].
+    T cumsum(std::size_t t0, std::size_t t1) const
+    {
+        assert(t0 > 0); // t0 must start from 1.
+        assert(t1 >= t0);
+
+        return prefix_sum(t1) - prefix_sum(t0-1);
+    }
+
+  private:
+    // prefix_sum returns cumulative sum of bins from [1, t].
+    T prefix_sum(std::size_t t) const
+    {
+        T sum{0};
+        std::size_t ind{t};
+        while (ind > 0) {
+            sum += tree_[ind].load(std::memory_order_relaxed);
+            ind -= ind & (-ind); // Left parent one-level higher in tree.
+        }
+        return sum;
+    }
+
+    std::vector<std::atomic<T>> tree_;
+};
+
+// ShardedBinaryIndexedTree provides the add and cumsum operations to many
+// threads by giving each writer a shard of its own, which are summed by
+// cumsum.
+//
+// Since each shard has a single writer, add updates each bin with a relaxed
+// load and store rather than a read-modify-write, and writers never contend
+// for the same cache lines.  cumsum costs O(s log n) for s shards and has
+// the same consistency as ConcurrentBinaryIndexedTree: prefix sums,
+// cumsum(1, t), are bounded and never decrease, while range sums with
+// t0 > 1 have no bound.
+template <typename T,
+          std::enable_if_t<std::is_integral<T>::value>* = nullptr>
+class ShardedBinaryIndexedTree
+{
+  public:
+
+    // ShardedBinaryIndexedTree holds n samples from [1, n] in nshards
+    // shards.
+    ShardedBinaryIndexedTree(const std::size_t n, const std::size_t nshards)
+    {
+        shards_.reserve(nshards);
+        for (std::size_t i = 0; i < nshards; ++i) {
+            // Allocate each shard separately to keep shards apart in memory.
+            shards_.emplace_back(new Shard(n+1));
+            for (auto& bin : *shards_.back()) {
+                bin.store(T{0}, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // add increments the bin at t by x, where only one thread may add to
+    // each shard.
+    void add(std::size_t shard, std::size_t t, T x)
+    {
+        assert(shard < shards_.size());
+        assert(t > 0); // t must start from 1.
+
+        auto& tree = *shards_[shard];
+        std::size_t ind{t};
+        while (ind < tree.size()) {
+            auto bin = tree[ind].load(std::memory_order_relaxed);
+            tree[ind].store(bin + x, std::memory_order_relaxed);
+            ind += ind & (-ind); // Right parent one-level higher in tree.
+        }
+    }
+
+    // cumsum returns cumulative sum of bins from [t0, t1] over all shards.
+    T cumsum(std::size_t t0, std::size_t t1) const
+    {
+        assert(t0 > 0); // t0 must start from 1.
+        assert(t1 >= t0);
+
+        T sum{0};
+        for (const auto& shard : shards_) {
+            sum += prefix_sum(*shard, t1) - prefix_sum(*shard, t0-1);
+        }
+        return sum;
+    }
+
+  private:
+    using Shard = std::vector<std::atomic<T>>;
+
+    // prefix_sum returns cumulative sum of bins from [1, t] in tree.
+    static T prefix_sum(const Shard& tree, std::size_t t)
+    {
+        T sum{0};
+        std::size_t ind{t};
+        while (ind > 0) {
+            sum += tree[ind].load(std::memory_order_relaxed);
+            ind -= ind & (-ind); // Left parent one-level higher in tree.
+        }
+        return sum;
+    }
+
+    std::vector<std::unique_ptr<Shard>> shards_;
+};
+
+// CompressedBinaryIndexedTree provides the add and cumsum operations over a
+// known set of keys from a huge key space, such as 64-bit timestamps, using
+// storage proportional to the number of distinct keys.
+//
+// The keys are sorted and each is mapped to its rank in [1, n], which is
+// its bin in a BinaryIndexedTree, so add and cumsum cost O(log n) plus a
+// binary search for the rank.
+template <typename Key, typename T,
+          std::enable_if_t<std::is_integral<T>::value>* = nullptr>
+class CompressedBinaryIndexedTree
+{
+  public:
+
+    // CompressedBinaryIndexedTree holds a bin for each key in [first, last),
+    // which may be unsorted and repeated.
+    template <typename InputIt>
+    CompressedBinaryIndexedTree(InputIt first, InputIt last)
+        : keys_(first, last)
+        , tree_(0)
+    {
+        std::sort(std::begin(keys_), std::end(keys_));
+        keys_.erase(std::unique(std::begin(keys_), std::end(keys_)),
+                    std::end(keys_));
+        tree_ = BinaryIndexedTree<T>(keys_.size());
+    }
+
+    // add increments the bin at key by x, where key must be one of the keys
+    // given to the constructor.
+    void add(const Key& key, T x)
+    {
+        auto it = std::lower_bound(std::begin(keys_), std::end(keys_), key);
+        if (it == std::end(keys_) || *it != key) {
+            throw std::out_of_range("key not in tree");
+        }
+        tree_.add(it - std::begin(keys_) + 1, x);
+    }
+
+    // cumsum returns cumulative sum of bins with keys from [k0, k1], where
+    // k0 and k1 need not be keys given to the constructor.
+    T cumsum(const Key& k0, const Key& k1) const
+    {
+        assert(!(k1 < k0));
+
+        // The bins in range are the ranks from [t0, t1].
+        std::size_t t0 = std::lower_bound(std::begin(keys_), std::end(keys_),
+                                          k0) - std::begin(keys_) + 1;
+        std::size_t t1 = std::upper_bound(std::begin(keys_), std::end(keys_),
+                                          k1) - std::begin(keys_);
+        if (t1 < t0) {
+            return T{0};
+        }
+        return tree_.cumsum(t0, t1);
+    }
+
+    // size returns the number of distinct keys.
+    std::size_t size() const
+    {
+        return keys_.size();
+    }
+
+  private:
+    // keys_ holds the sorted distinct keys, where the bin of keys_[i] is
+    // i+1.
+    std::vector<Key> keys_;
+    BinaryIndexedTree<T> tree_;
+};
+
+// HashedBinaryIndexedTree provides the add and cumsum operations over the
+// key space [0, 2^64-1] when the keys are not known in advance.
+//
+// The tree is the BinaryIndexedTree over every possible key, but only the
+// bins which have been added to are stored, in a hash map.  Each add stores
+// at most 64 bins, so storage is proportional to the number of distinct
+// keys, and add and cumsum visit at most 65 bins.
+//
+// Key k is stored at index k+1 so that key 0 has a bin.  The largest key
+// would wrap to index 0, which the tree never visits otherwise, so its bin
+// is held at index 0 and added to prefix sums explicitly.
+template <typename T,
+          std::enable_if_t<std::is_integral<T>::value>* = nullptr>
+class HashedBinaryIndexedTree
+{
+  public:
+
+    // add increments the bin at key by x.
+    void add(std::uint64_t key, T x)
+    {
+        if (key == max_key) {
+            tree_[0] += x;
+            return;
+        }
+
+        // Stop when the index passes the largest key and wraps to 0.
+        std::uint64_t ind{key + 1};
+        while (ind > 0) {
+            tree_[ind] += x;
+            ind += ind & (-ind); // Right parent one-level higher in tree.
+        }
+    }
+
+    // cumsum returns cumulative sum of bins from [k0, k1].
+    T cumsum(std::uint64_t k0, std::uint64_t k1) const
+    {
+        assert(k1 >= k0);
+
+        if (k0 == 0) {
+            return prefix_sum(k1);
+        }
+        return prefix_sum(k1) - prefix_sum(k0-1);
+    }
+
+    // size returns the number of bins stored.
+    std::size_t size() const
+    {
+        return tree_.size();
+    }
+
+  private:
+    static constexpr std::uint64_t max_key{
+        std::numeric_limits<std::uint64_t>::max()};
+
+    // prefix_sum returns cumulative sum of bins from [0, key].
+    T prefix_sum(std::uint64_t key) const
+    {
+        T sum{0};
+        if (key == max_key) {
+            sum += bin(0);
+            --key;
+        }
+        std::uint64_t ind{key + 1};
+        while (ind > 0) {
+            sum += bin(ind);
+            ind -= ind & (-ind); // Left parent one-level higher in tree.
+        }
+        return sum;
+    }
+
+    // bin returns the value stored at ind, or 0 when nothing is stored.
+    T bin(std::uint64_t ind) const
+    {
+        auto it = tree_.find(ind);
+        return it != std::end(tree_) ? it->second : T{0};
+    }
+
+    std::unordered_map<std::uint64_t, T> tree_;
+};
+
+// BinaryIndexedTreeND extends BinaryIndexedTree to N dimensions, where each
+// operation visits O(log n) bins along each dimension, for O(log^N n) time.
+//
+// The bins are held in a single flat array in row-major order, and the loop
+// over each dimension is unrolled at compile time by recursing on the
+// dimension as a template parameter.
+template <typename T, std::size_t N,
+          std::enable_if_t<std::is_integral<T>::value && (N > 0)>* = nullptr>
+class BinaryIndexedTreeND
+{
+  public:
+    // Index holds the bin along each dimension, starting from 1.
+    using Index = std::array<std::size_t, N>;
+
+    // Rect holds the bins from [lo, hi] along each dimension.
+    struct Rect
+    {
+        Index lo;
+        Index hi;
+    };
+
+    // BinaryIndexedTreeND holds n[d] samples from [1, n[d]] along each
+    // dimension d.
+    BinaryIndexedTreeND(const Index& n)
+        : n_(n)
+    {
+        std::size_t size{1};
+        for (auto nd : n_) {
+            size *= nd+1;
+        }
+        tree_.resize(size);
+    }
+
+    // add increments the bin at t by x.
+    void add(const Index& t, T x)
+    {
+        for (std::size_t d = 0; d < N; ++d) {
+            assert(t[d] > 0); // t must start from 1.
+        }
+        add<0>(t, 0, x);
+    }
+
+    // add increments the bin at (t[0], ..., t[N-1]) by x, e.g. add(i, j, x).
+    template <typename... Args,
+              std::enable_if_t<sizeof...(Args) == N+1>* = nullptr>
+    void add(Args... args)
+    {
+        auto tuple = std::make_tuple(args...);
+        add(make_index(tuple, std::make_index_sequence<N>{}),
+            static_cast<T>(std::get<N>(tuple)));
+    }
+
+    // sum returns the sum of the bins in rect.
+    T sum(const Rect& rect) const
+    {
+        // By inclusion-exclusion, add or subtract the prefix sums at each of
+        // the 2^N corners, choosing lo-1 or hi along each dimension, with
+        // the sign given by the number of lo-1 choices.
+        T total{0};
+        for (std::size_t mask = 0; mask < (std::size_t{1} << N); ++mask) {
+            Index corner;
+            bool negative{false};
+            for (std::size_t d = 0; d < N; ++d) {
+                assert(rect.lo[d] > 0); // lo must start from 1.
+                assert(rect.hi[d] >= rect.lo[d]);
+                if (mask & (std::size_t{1} << d)) {
+                    corner[d] = rect.lo[d]-1;
+                    negative = !negative;
+                } else {
+                    corner[d] = rect.hi[d];
+                }
+            }
+            T prefix = prefix_sum<0>(corner, 0);
+            total = negative ? total - prefix : total + prefix;
+        }
+        return total;
+    }
+
   private:
+    // add increments the bins along dimension D and beyond, where offset is
+    // the flat index of the bins chosen along the preceding dimensions.
+    template <std::size_t D>
+    void add(const Index& t, std::size_t offset, T x)
+    {
+        if constexpr (D == N) {
+            tree_[offset] += x;
+        } else {
+            std::size_t ind{t[D]};
+            while (ind <= n_[D]) {
+                add<D+1>(t, offset*(n_[D]+1) + ind, x);
+                ind += ind & (-ind); // Right parent one-level higher in tree.
+            }
+        }
+    }
+
+    // prefix_sum returns the sum of the bins from [1, t] along dimension D
+    // and beyond, where offset is as for add.
+    template <std::size_t D>
+    T prefix_sum(const Index& t, std::size_t offset) const
+    {
+        if constexpr (D == N) {
+            return tree_[offset];
+        } else {
+            T sum{0};
+            std::size_t ind{t[D]};
+            while (ind > 0) {
+                sum += prefix_sum<D+1>(t, offset*(n_[D]+1) + ind);
+                ind -= ind & (-ind); // Left parent one-level higher in tree.
+            }
+            return sum;
+        }
+    }
+
+    // make_index returns the first N elements of tuple as an Index.
+    template <typename Tuple, std::size_t... Is>
+    static Index make_index(const Tuple& tuple, std::index_sequence<Is...>)
+    {
+        return Index{static_cast<std::size_t>(std::get<Is>(tuple))...};
+    }
+
+    Index n_;
     // tree_ holds the binary indexed tree as a flat array.
     std::vector<T> tree_;
 };
@@ -151,3 +727,485 @@ TEST_CASE("examples", "[BinaryIndexedTree]")
         }
     }
 }
+
+TEST_CASE("bulk construction", "[BinaryIndexedTree]")
+{
+    using T = std::int64_t;
+
+    // Bulk construction yields the same tree as adding each bin.
+    for (std::size_t n : {0, 1, 2, 7, 8, 14, 100}) {
+        std::vector<T> bins(n);
+        std::iota(std::begin(bins), std::end(bins), T{-3});
+        BinaryIndexedTree<T> expected(n);
+        for (std::size_t t = 1; t <= n; ++t) {
+            expected.add(t, bins[t-1]);
+        }
+        BinaryIndexedTree<T> bit(std::begin(bins), std::end(bins));
+        REQUIRE(bit.size() == n);
+        for (std::size_t t = 1; t <= n; ++t) {
+            CAPTURE(n, t);
+            REQUIRE(bit.cumsum(1, t) == expected.cumsum(1, t));
+        }
+    }
+
+    // Reset replaces the bins and may change the number of bins.
+    T bins[] = {1, 7, 3, 0, 5, 8, 3, 2, 6, 2, 1, 1, 4, 5};
+    BinaryIndexedTree<T> bit(std::begin(bins), std::begin(bins)+4);
+    REQUIRE(bit.cumsum(1, 4) == 11);
+    bit.reset(std::begin(bins), std::end(bins));
+    REQUIRE(bit.size() == 14);
+    REQUIRE(bit.cumsum(1, 14) == 48);
+    REQUIRE(bit.cumsum(5, 7) == 16);
+    bit.add(6, 10);
+    REQUIRE(bit.cumsum(5, 7) == 26);
+}
+
+TEST_CASE("bulk construction benchmark", "[.benchmark][BinaryIndexedTree]")
+{
+    using T = std::int64_t;
+
+    std::size_t n{1000000};
+    std::vector<T> bins(n);
+    std::iota(std::begin(bins), std::end(bins), T{0});
+
+    BENCHMARK("add")
+    {
+        BinaryIndexedTree<T> bit(n);
+        for (std::size_t t = 1; t <= n; ++t) {
+            bit.add(t, bins[t-1]);
+        }
+        return bit.cumsum(1, n);
+    };
+
+    BENCHMARK("bulk")
+    {
+        BinaryIndexedTree<T> bit(std::begin(bins), std::end(bins));
+        return bit.cumsum(1, n);
+    };
+}
+
+TEST_CASE("lower_bound", "[BinaryIndexedTree]")
+{
+    using T = std::int64_t;
+
+    // Compare to a linear scan over the prefix sums, including empty bins.
+    for (std::size_t n : {1, 2, 7, 8, 14, 100}) {
+        std::vector<T> bins(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            bins[i] = (i*7) % 4;
+        }
+        BinaryIndexedTree<T> bit(std::begin(bins), std::end(bins));
+        T total = std::accumulate(std::begin(bins), std::end(bins), T{0});
+        for (T value = 0; value <= total+1; ++value) {
+            std::size_t expected{1};
+            T sum{bins[0]};
+            while (expected <= n && sum < value) {
+                sum += expected < n ? bins[expected] : 0;
+                ++expected;
+            }
+            auto rcv = bit.lower_bound(value);
+            CAPTURE(n, value, expected, rcv);
+            REQUIRE(rcv == expected);
+        }
+    }
+
+    // Bin t counts the samples equal to t in {1, 2, 2, 5, 5, 5}.
+    T counts[] = {1, 2, 0, 0, 3};
+    BinaryIndexedTree<T> bit(std::begin(counts), std::end(counts));
+    std::vector<std::size_t> expected{1, 2, 2, 5, 5, 5, 6};
+    for (std::size_t k = 1; k <= expected.size(); ++k) {
+        CAPTURE(k);
+        REQUIRE(bit.find_kth(k) == expected[k-1]);
+    }
+}
+
+TEST_CASE("lower_bound benchmark", "[.benchmark][BinaryIndexedTree]")
+{
+    using T = std::int64_t;
+
+    std::size_t n{1000000};
+    std::vector<T> bins(n, 3);
+    BinaryIndexedTree<T> bit(std::begin(bins), std::end(bins));
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<T> dis(1, 3*n);
+    std::vector<T> values(1000);
+    for (auto& value : values) {
+        value = dis(gen);
+    }
+
+    BENCHMARK("binary search over cumsum")
+    {
+        std::size_t result{0};
+        for (const auto value : values) {
+            std::size_t lo{1}, hi{n+1};
+            while (lo < hi) {
+                std::size_t mid = lo + (hi-lo)/2;
+                if (bit.cumsum(1, mid) < value) {
+                    lo = mid+1;
+                } else {
+                    hi = mid;
+                }
+            }
+            result += lo;
+        }
+        return result;
+    };
+
+    BENCHMARK("lower_bound")
+    {
+        std::size_t result{0};
+        for (const auto value : values) {
+            result += bit.lower_bound(value);
+        }
+        return result;
+    };
+}
+
+TEST_CASE("range examples", "[RangeBinaryIndexedTree]")
+{
+    using T = std::int64_t;
+
+    std::size_t n{10};
+    RangeBinaryIndexedTree<T> bit{n};
+
+    // Apply range updates of (t0, t1, x).
+    typedef std::tuple<std::size_t, std::size_t, T> Op;
+    std::vector<Op> ops{
+        {1,10,1},{3,5,2},{5,5,-4},{8,10,3},{1,1,7}
+    };
+    for (const auto& op : ops) {
+        auto t0 = std::get<0>(op);
+        auto t1 = std::get<1>(op);
+        auto x = std::get<2>(op);
+        bit.range_add(t0, t1, x);
+    }
+
+    // Bins are {8, 1, 3, 3, -1, 1, 1, 4, 4, 4}.
+    typedef std::tuple<std::size_t, std::size_t, T> Sum;
+    std::vector<Sum> sums{
+        {1,1,8},{1,2,9},{1,5,14},{1,10,28},{5,5,-1},{3,6,6},{8,10,12},
+        {2,9,16}
+    };
+    for (const auto& sum : sums) {
+        auto t0 = std::get<0>(sum);
+        auto t1 = std::get<1>(sum);
+        auto expected = std::get<2>(sum);
+        auto rcv = bit.range_sum(t0, t1);
+        CAPTURE(t0, t1, expected, rcv);
+        REQUIRE(rcv == expected);
+    }
+}
+
+TEST_CASE("range random", "[RangeBinaryIndexedTree]")
+{
+    using T = std::int64_t;
+
+    std::size_t n{50};
+    RangeBinaryIndexedTree<T> bit{n};
+    std::vector<T> bins(n+1, 0); // Naive bins from [1, n].
+
+    // Compare range sums to the naive bins after each random update.
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<std::size_t> tdis(1, n);
+    std::uniform_int_distribution<T> xdis(-100, 100);
+    for (std::size_t i = 0; i < 200; ++i) {
+        auto t0 = tdis(gen), t1 = tdis(gen);
+        if (t0 > t1) {
+            std::swap(t0, t1);
+        }
+        auto x = xdis(gen);
+        if (i % 2 == 0) {
+            bit.range_add(t0, t1, x);
+            for (auto t = t0; t <= t1; ++t) {
+                bins[t] += x;
+            }
+        } else {
+            bit.add(t0, x);
+            bins[t0] += x;
+        }
+
+        t0 = tdis(gen), t1 = tdis(gen);
+        if (t0 > t1) {
+            std::swap(t0, t1);
+        }
+        auto expected = std::accumulate(std::begin(bins)+t0,
+                                        std::begin(bins)+t1+1, T{0});
+        auto rcv = bit.range_sum(t0, t1);
+        CAPTURE(i, t0, t1, expected, rcv);
+        REQUIRE(rcv == expected);
+    }
+}
+
+TEST_CASE("2d", "[BinaryIndexedTreeND]")
+{
+    using T = std::int64_t;
+
+    std::size_t nrow{7}, ncol{12};
+    BinaryIndexedTreeND<T, 2> bit({nrow, ncol});
+    std::vector<std::vector<T>> bins(nrow+1, std::vector<T>(ncol+1, 0));
+
+    // Compare rectangle sums to the naive bins after each random update.
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<std::size_t> idis(1, nrow), jdis(1, ncol);
+    std::uniform_int_distribution<T> xdis(-100, 100);
+    for (std::size_t k = 0; k < 200; ++k) {
+        auto i = idis(gen), j = jdis(gen);
+        auto x = xdis(gen);
+        bit.add(i, j, x);
+        bins[i][j] += x;
+
+        auto i0 = idis(gen), i1 = idis(gen), j0 = jdis(gen), j1 = jdis(gen);
+        if (i0 > i1) {
+            std::swap(i0, i1);
+        }
+        if (j0 > j1) {
+            std::swap(j0, j1);
+        }
+        T expected{0};
+        for (auto ii = i0; ii <= i1; ++ii) {
+            for (auto jj = j0; jj <= j1; ++jj) {
+                expected += bins[ii][jj];
+            }
+        }
+        auto rcv = bit.sum({{i0, j0}, {i1, j1}});
+        CAPTURE(k, i0, i1, j0, j1, expected, rcv);
+        REQUIRE(rcv == expected);
+    }
+}
+
+TEST_CASE("3d", "[BinaryIndexedTreeND]")
+{
+    using T = std::int32_t;
+
+    BinaryIndexedTreeND<T, 3> bit({4, 5, 6});
+
+    // Set every bin to 1, except for a single bin set to 10.
+    for (std::size_t i = 1; i <= 4; ++i) {
+        for (std::size_t j = 1; j <= 5; ++j) {
+            for (std::size_t k = 1; k <= 6; ++k) {
+                bit.add({i, j, k}, 1);
+            }
+        }
+    }
+    bit.add(2, 3, 4, 9);
+
+    typedef std::tuple<BinaryIndexedTreeND<T, 3>::Rect, T> Sum;
+    std::vector<Sum> sums{
+        {{{1, 1, 1}, {4, 5, 6}}, 129},
+        {{{2, 3, 4}, {2, 3, 4}}, 10},
+        {{{1, 1, 1}, {1, 5, 6}}, 30},
+        {{{2, 2, 2}, {3, 4, 5}}, 33},
+        {{{3, 1, 1}, {4, 5, 6}}, 60},
+        {{{1, 1, 5}, {4, 5, 6}}, 40}
+    };
+    for (const auto& sum : sums) {
+        auto rect = std::get<0>(sum);
+        auto expected = std::get<1>(sum);
+        auto rcv = bit.sum(rect);
+        CAPTURE(expected, rcv);
+        REQUIRE(rcv == expected);
+    }
+}
+
+TEST_CASE("concurrent", "[ConcurrentBinaryIndexedTree]")
+{
+    using T = std::int64_t;
+
+    std::size_t n{100}, nthreads{4}, nadds{20000};
+    ConcurrentBinaryIndexedTree<T> bit(n);
+    ShardedBinaryIndexedTree<T> sharded(n, nthreads);
+
+    // Each writer adds 1 to bins [1, n] in turn, so bin t ends with
+    // nthreads*nadds/n.  A reader checks that successive prefix sums of the
+    // same t never decrease and never exceed their final value.  Range sums
+    // with t0 > 1 have no such bound and are only checked after the join.
+    std::atomic<bool> done{false};
+    bool ordered{true};
+    std::vector<std::size_t> ends{1, n/4, n/2, n - 1, n};
+    auto final_sum = [&](std::size_t t0, std::size_t t1) {
+        return static_cast<T>(nthreads*nadds/n*(t1 - t0 + 1));
+    };
+    std::thread reader([&]() {
+        std::vector<T> last(ends.size(), 0), sharded_last(ends.size(), 0);
+        while (!done.load()) {
+            for (std::size_t ii = 0; ii < ends.size(); ++ii) {
+                auto sum = bit.cumsum(1, ends[ii]);
+                auto sharded_sum = sharded.cumsum(1, ends[ii]);
+                if (sum < last[ii] || sum > final_sum(1, ends[ii]) ||
+                    sharded_sum < sharded_last[ii] ||
+                    sharded_sum > final_sum(1, ends[ii])) {
+                    ordered = false;
+                }
+                last[ii] = sum;
+                sharded_last[ii] = sharded_sum;
+            }
+        }
+    });
+    std::vector<std::thread> writers;
+    for (std::size_t id = 0; id < nthreads; ++id) {
+        writers.emplace_back([&, id]() {
+            for (std::size_t i = 0; i < nadds; ++i) {
+                bit.add(i % n + 1, 1);
+                sharded.add(id, i % n + 1, 1);
+            }
+        });
+    }
+    for (auto& writer : writers) {
+        writer.join();
+    }
+    done.store(true);
+    reader.join();
+    REQUIRE(ordered);
+
+    // Once the writers have been joined, every sum is exact.
+    for (std::size_t t = 1; t <= n; ++t) {
+        CAPTURE(t);
+        REQUIRE(bit.cumsum(1, t) == final_sum(1, t));
+        REQUIRE(sharded.cumsum(1, t) == final_sum(1, t));
+    }
+    for (auto t0 : ends) {
+        for (auto t1 : ends) {
+            if (t0 <= t1) {
+                CAPTURE(t0, t1);
+                REQUIRE(bit.cumsum(t0, t1) == final_sum(t0, t1));
+                REQUIRE(sharded.cumsum(t0, t1) == final_sum(t0, t1));
+            }
+        }
+    }
+}
+
+TEST_CASE("concurrent benchmark",
+          "[.benchmark][ConcurrentBinaryIndexedTree]")
+{
+    using T = std::int64_t;
+
+    std::size_t n{1 << 16}, nadds{1 << 20};
+
+    // Each benchmark makes nadds in total, split evenly between threads.
+    auto run = [nadds](std::size_t nthreads, auto add) {
+        std::vector<std::thread> threads;
+        for (std::size_t id = 0; id < nthreads; ++id) {
+            threads.emplace_back([=]() {
+                std::mt19937 gen(id);
+                std::uniform_int_distribution<std::size_t> dis(1, 1 << 16);
+                for (std::size_t i = 0; i < nadds/nthreads; ++i) {
+                    add(id, dis(gen));
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    };
+
+    for (std::size_t nthreads : {1, 2, 4, 8, 16, 32, 64}) {
+        std::string suffix = " " + std::to_string(nthreads) + " threads";
+
+        BinaryIndexedTree<T> bit(n);
+        std::mutex mutex;
+        BENCHMARK("mutex" + suffix)
+        {
+            run(nthreads, [&](std::size_t, std::size_t t) {
+                std::lock_guard<std::mutex> lock(mutex);
+                bit.add(t, 1);
+            });
+        };
+
+        ConcurrentBinaryIndexedTree<T> concurrent(n);
+        BENCHMARK("concurrent" + suffix)
+        {
+            run(nthreads, [&](std::size_t, std::size_t t) {
+                concurrent.add(t, 1);
+            });
+        };
+
+        ShardedBinaryIndexedTree<T> sharded(n, nthreads);
+        BENCHMARK("sharded" + suffix)
+        {
+            run(nthreads, [&](std::size_t id, std::size_t t) {
+                sharded.add(id, t, 1);
+            });
+        };
+    }
+}
+
+TEST_CASE("sparse", "[CompressedBinaryIndexedTree]")
+{
+    using T = std::int64_t;
+
+    // Draw keys from the full 64-bit key space, including its extremes.
+    std::mt19937_64 gen(42);
+    std::vector<std::uint64_t> keys(500);
+    for (auto& key : keys) {
+        key = gen();
+    }
+    keys[0] = 0;
+    keys[1] = std::numeric_limits<std::uint64_t>::max();
+    keys[2] = keys[3]; // Repeated keys share a bin.
+    keys[4] = keys[1] - 1;
+
+    CompressedBinaryIndexedTree<std::uint64_t, T> compressed(
+        std::begin(keys), std::end(keys));
+    HashedBinaryIndexedTree<T> hashed;
+    std::map<std::uint64_t, T> bins;
+    REQUIRE(compressed.size() == 499);
+
+    // Put a distinct value in the bins of the extreme keys.
+    for (std::size_t ii : {0, 1, 4}) {
+        compressed.add(keys[ii], static_cast<T>(ii + 1));
+        hashed.add(keys[ii], static_cast<T>(ii + 1));
+        bins[keys[ii]] += static_cast<T>(ii + 1);
+    }
+
+    // Compare sums over random ranges to the naive bins after each update.
+    std::uniform_int_distribution<std::size_t> kdis(0, keys.size()-1);
+    std::uniform_int_distribution<T> xdis(-100, 100);
+    for (std::size_t i = 0; i < 300; ++i) {
+        auto key = keys[kdis(gen)];
+        auto x = xdis(gen);
+        compressed.add(key, x);
+        hashed.add(key, x);
+        bins[key] += x;
+
+        // Range ends are alternately keys and arbitrary values.
+        std::uint64_t k0 = i % 2 ? keys[kdis(gen)] : gen();
+        std::uint64_t k1 = i % 2 ? keys[kdis(gen)] : gen();
+        if (k0 > k1) {
+            std::swap(k0, k1);
+        }
+        T expected{0};
+        for (auto it = bins.lower_bound(k0);
+             it != std::end(bins) && it->first <= k1; ++it) {
+            expected += it->second;
+        }
+        CAPTURE(i, k0, k1, expected);
+        REQUIRE(compressed.cumsum(k0, k1) == expected);
+        REQUIRE(hashed.cumsum(k0, k1) == expected);
+    }
+
+    // Sums over the whole key space and over empty ranges.
+    T total{0};
+    for (const auto& bin : bins) {
+        total += bin.second;
+    }
+    auto max = std::numeric_limits<std::uint64_t>::max();
+    REQUIRE(compressed.cumsum(0, max) == total);
+    REQUIRE(hashed.cumsum(0, max) == total);
+    REQUIRE(compressed.cumsum(2, 2) == 0);
+    REQUIRE(hashed.cumsum(2, 2) == 0);
+
+    // The extreme keys each have their own bin.
+    for (auto key : {std::uint64_t{0}, max - 1, max}) {
+        CAPTURE(key);
+        REQUIRE(hashed.cumsum(key, key) == bins[key]);
+        REQUIRE(compressed.cumsum(key, key) == bins[key]);
+    }
+    REQUIRE(hashed.cumsum(1, max) == total - bins[0]);
+    REQUIRE(hashed.cumsum(0, max - 1) == total - bins[max]);
+
+    // Storage grows with the number of distinct keys, not the key space.
+    REQUIRE(hashed.size() <= 64*bins.size());
+
+    // Only the keys given to the constructor have bins.
+    REQUIRE_THROWS_AS(compressed.add(2, 1), std::out_of_range);
+}